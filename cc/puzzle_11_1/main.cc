@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -21,31 +22,25 @@ class PainterBot {
     absl::flat_hash_set<Position> white;
     white.insert(position_);
 
-    aoc2019::IntcodeMachine::RunResult result;
-    do {
-      result = brain_.Run();
-      if (!result.outputs.empty()) {
-        CHECK(result.outputs.size() == 2);
-
-        switch (result.outputs.front()) {
-          case 0:
-            white.erase(position_);
-            break;
-          case 1:
-            white.insert(position_);
-            break;
-          default:
-            std::cerr << "Invalid paint command: " << result.outputs.front();
-            CHECK(false);
-        }
-
-        Move(result.outputs.back());
+    brain_.SetInputSource([this, &white]() -> std::optional<std::int64_t> {
+      return white.contains(position_) ? 1 : 0;
+    });
+    aoc2019::IntcodeOutputs outputs(&brain_);
+    while (const std::optional<std::int64_t> color = outputs.Next()) {
+      switch (*color) {
+        case 0:
+          white.erase(position_);
+          break;
+        case 1:
+          white.insert(position_);
+          break;
+        default:
+          std::cerr << "Invalid paint command: " << *color;
+          CHECK(false);
       }
-
-      if (result.state == aoc2019::IntcodeMachine::ExecState::kPendingInput) {
-        brain_.PushInputs({white.contains(position_) ? 1 : 0});
-      }
-    } while (result.state != aoc2019::IntcodeMachine::ExecState::kHalt);
+      Move(outputs.NextOrDie());
+    }
+    CHECK(outputs.state() == aoc2019::IntcodeMachine::ExecState::kHalt);
 
     return Render(white);
   }
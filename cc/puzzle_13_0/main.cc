@@ -9,18 +9,15 @@ int main(int argc, char** argv) {
     return 1;
   }
   aoc2019::IntcodeMachine machine(aoc2019::ReadIntcodeProgram(argv[1]));
-  aoc2019::IntcodeMachine::RunResult result = machine.Run();
-  CHECK(result.state == aoc2019::IntcodeMachine::ExecState::kHalt);
-  CHECK(result.outputs.size() % 3 == 0);
+  aoc2019::IntcodeOutputs outputs(&machine);
   int blocks = 0;
-  while (!result.outputs.empty()) {
-    result.outputs.pop_front();
-    result.outputs.pop_front();
-    if (result.outputs.front() == 2) {
+  while (outputs.Next().has_value()) {
+    outputs.NextOrDie();
+    if (outputs.NextOrDie() == 2) {
       ++blocks;
     }
-    result.outputs.pop_front();
   }
+  CHECK(outputs.state() == aoc2019::IntcodeMachine::ExecState::kHalt);
   std::cout << blocks << "\n";
   return 0;
 }
@@ -3,7 +3,9 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <deque>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -31,55 +33,48 @@ class ArcadeMachine {
       : cpu_(std::move(program)) {}
 
   std::deque<std::int64_t> Run(std::deque<std::int64_t> moves) {
-    cpu_.PushInputs(moves);
-    aoc2019::IntcodeMachine::RunResult result;
-    do {
-      result = cpu_.Run();
-
-      CHECK(result.outputs.size() % 3 == 0);
-      while (!result.outputs.empty()) {
-        const std::int64_t x = result.outputs.front();
-        result.outputs.pop_front();
-        const std::int64_t y = result.outputs.front();
-        result.outputs.pop_front();
-        const std::int64_t tile = result.outputs.front();
-        result.outputs.pop_front();
-        if (x == -1 && y == 0) {
-          score_ = tile;
-        } else {
-          display_.DrawTile(x, y, tile);
-        }
-      }
-      display_.Render();
-      std::cout << "\nSCORE: " << score_ << "\n";
-
-      while (result.state ==
-             aoc2019::IntcodeMachine::ExecState::kPendingInput) {
+    cpu_.PushInputs(moves.begin(), moves.end());
+    cpu_.SetInputSource([this, &moves]() -> std::optional<std::int64_t> {
+      Render();
+      for (;;) {
         switch (getch()) {
           case 'a':
             moves.push_back(-1);
-            cpu_.PushInputs({-1});
-            break;
+            return -1;
           case 's':
             moves.push_back(0);
-            cpu_.PushInputs({0});
-            break;
+            return 0;
           case 'd':
             moves.push_back(1);
-            cpu_.PushInputs({1});
-            break;
+            return 1;
           default:
-            continue;
+            break;
         }
-        break;
       }
-    } while (result.state != aoc2019::IntcodeMachine::ExecState::kHalt);
-
+    });
+    aoc2019::IntcodeOutputs outputs(&cpu_);
+    while (const std::optional<std::int64_t> x = outputs.Next()) {
+      const std::int64_t y = outputs.NextOrDie();
+      const std::int64_t tile = outputs.NextOrDie();
+      if (*x == -1 && y == 0) {
+        score_ = tile;
+      } else {
+        display_.DrawTile(*x, y, tile);
+      }
+    }
+    CHECK(outputs.state() == aoc2019::IntcodeMachine::ExecState::kHalt);
+    cpu_.SetInputSource(nullptr);
+    Render();
     std::cout << "FINAL SCORE: " << score_ << "\n";
     return moves;
   }
 
  private:
+  void Render() const {
+    display_.Render();
+    std::cout << "\nSCORE: " << score_ << "\n";
+  }
+
   class Display {
    public:
     Display() = default;
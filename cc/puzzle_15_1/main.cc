@@ -1,6 +1,6 @@
 #include <cstdint>
-#include <deque>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -9,6 +9,7 @@
 #include "absl/hash/hash.h"
 #include "cc/util/check.h"
 #include "cc/util/intcode.h"
+#include "cc/util/intcode_pool.h"
 
 namespace {
 
@@ -40,72 +41,79 @@ struct Position {
         CHECK(false);
     }
   }
+};
 
-  static Position FromMoveSequence(const std::deque<std::int64_t> seq) {
-    Position pos;
-    for (const std::int64_t move : seq) {
-      pos = pos.Move(move);
-    }
-    return pos;
+// A repair droid, paused waiting for its next movement command.
+struct Droid {
+  aoc2019::IntcodeMachine machine;
+  // Where the droid last tried to move.
+  Position pos;
+  // Status code reported for that move.
+  std::int64_t status = 1;
+
+  // Returns a fork of this droid that has tried to move in 'direction'.
+  Droid TryMove(std::int64_t direction) const {
+    Droid moved{aoc2019::IntcodeMachinePool::ForThread().Acquire(machine),
+                pos.Move(direction)};
+    moved.machine.PushInputs({direction});
+    std::optional<std::int64_t> status;
+    const aoc2019::IntcodeMachine::ExecState state = moved.machine.Run(
+        [&status](const std::int64_t output) { status = output; });
+    CHECK(state == aoc2019::IntcodeMachine::ExecState::kPendingInput);
+    CHECK(status.has_value());
+    moved.status = *status;
+    return moved;
+  }
+
+  // Hands this droid's machine back to the pool for later forks to reuse.
+  void Retire() {
+    aoc2019::IntcodeMachinePool::ForThread().Release(std::move(machine));
   }
 };
 
-// Returns the shortest path to the oxygen system.
-std::deque<std::int64_t>
-    BfsOxygenSearch(const std::vector<std::int64_t>& program) {
+// Returns a droid that has reached the oxygen system by a shortest path.
+Droid BfsOxygenSearch(const std::vector<std::int64_t>& program) {
   absl::flat_hash_set<Position> horizon{{0, 0}};
-  std::vector<std::deque<std::int64_t>> paths{{1}, {2}, {3}, {4}};
+  std::vector<Droid> droids;
+  droids.push_back(Droid{aoc2019::IntcodeMachine(program), {0, 0}});
   for (;;) {
-    std::vector<std::deque<std::int64_t>> next_paths;
-    for (std::deque<std::int64_t>& candidate_path : paths) {
-      aoc2019::IntcodeMachine droid(program);
-      droid.PushInputs(candidate_path);
-      aoc2019::IntcodeMachine::RunResult result = droid.Run();
-      CHECK(result.state == aoc2019::IntcodeMachine::ExecState::kPendingInput);
-      CHECK(!result.outputs.empty());
-      if (result.outputs.back() == 2) {
-        return std::move(candidate_path);
+    std::vector<Droid> next_droids;
+    for (Droid& droid : droids) {
+      if (droid.status == 2) {
+        return std::move(droid);
       }
-      if (result.outputs.back() == 1) {
-        Position current_pos = Position::FromMoveSequence(candidate_path);
+      if (droid.status == 1) {
         for (std::int64_t next_move : {1, 2, 3, 4}) {
-          if (horizon.insert(current_pos.Move(next_move)).second) {
-            next_paths.emplace_back(candidate_path);
-            next_paths.back().push_back(next_move);
+          if (horizon.insert(droid.pos.Move(next_move)).second) {
+            next_droids.push_back(droid.TryMove(next_move));
           }
         }
       }
     }
-    paths = std::move(next_paths);
+    for (Droid& droid : droids) droid.Retire();
+    droids = std::move(next_droids);
   }
 }
 
-int TimeToOxygenate(const std::vector<std::int64_t>& program,
-                    std::deque<int64_t> path_to_o2) {
-  absl::flat_hash_set<Position> oxygenated{
-      Position::FromMoveSequence(path_to_o2)};
-  std::vector<std::deque<std::int64_t>> paths{std::move(path_to_o2)};
+int TimeToOxygenate(Droid at_o2) {
+  absl::flat_hash_set<Position> oxygenated{at_o2.pos};
+  std::vector<Droid> droids;
+  droids.push_back(std::move(at_o2));
   int cycles = 0;
-  while (!paths.empty()) {
+  while (!droids.empty()) {
     ++cycles;
-    std::vector<std::deque<std::int64_t>> next_paths;
-    for (std::deque<std::int64_t>& candidate_path : paths) {
-      aoc2019::IntcodeMachine droid(program);
-      droid.PushInputs(candidate_path);
-      aoc2019::IntcodeMachine::RunResult result = droid.Run();
-      CHECK(result.state == aoc2019::IntcodeMachine::ExecState::kPendingInput);
-      CHECK(!result.outputs.empty());
-      if (result.outputs.back() != 0) {
-        Position current_pos = Position::FromMoveSequence(candidate_path);
+    std::vector<Droid> next_droids;
+    for (const Droid& droid : droids) {
+      if (droid.status != 0) {
         for (std::int64_t next_move : {1, 2, 3, 4}) {
-          if (oxygenated.insert(current_pos.Move(next_move)).second) {
-            next_paths.emplace_back(candidate_path);
-            next_paths.back().push_back(next_move);
+          if (oxygenated.insert(droid.pos.Move(next_move)).second) {
+            next_droids.push_back(droid.TryMove(next_move));
           }
         }
       }
     }
-    paths = std::move(next_paths);
+    for (Droid& droid : droids) droid.Retire();
+    droids = std::move(next_droids);
   }
   return cycles - 1;
 }
@@ -118,6 +126,6 @@ int main(int argc, char** argv) {
     return 1;
   }
   std::vector<std::int64_t> program = aoc2019::ReadIntcodeProgram(argv[1]);
-  std::cout << TimeToOxygenate(program, BfsOxygenSearch(program)) << "\n";
+  std::cout << TimeToOxygenate(BfsOxygenSearch(program)) << "\n";
   return 0;
 }
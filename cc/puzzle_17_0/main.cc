@@ -1,5 +1,4 @@
 #include <cstdint>
-#include <deque>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -9,15 +8,17 @@
 
 namespace {
 
-std::vector<std::string> AsciiGrid(const std::deque<std::int64_t>& output) {
+std::vector<std::string> AsciiGrid(aoc2019::IntcodeMachine* machine) {
   std::vector<std::string> grid(1);
-  for (const int64_t val : output) {
+  aoc2019::IntcodeOutputs outputs(machine);
+  for (const std::int64_t val : outputs) {
     if (val == '\n') {
       grid.emplace_back();
     } else {
       grid.back().push_back(static_cast<char>(val));
     }
   }
+  CHECK(outputs.state() == aoc2019::IntcodeMachine::ExecState::kHalt);
   if (grid.back().empty()) grid.pop_back();
   return grid;
 }
@@ -43,8 +44,6 @@ int main(int argc, char** argv) {
     return 1;
   }
   aoc2019::IntcodeMachine machine(aoc2019::ReadIntcodeProgram(argv[1]));
-  aoc2019::IntcodeMachine::RunResult result = machine.Run();
-  CHECK(result.state == aoc2019::IntcodeMachine::ExecState::kHalt);
-  std::cout << FindIntersections(AsciiGrid(result.outputs)) << "\n";
+  std::cout << FindIntersections(AsciiGrid(&machine)) << "\n";
   return 0;
 }
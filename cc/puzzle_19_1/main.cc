@@ -1,10 +1,11 @@
 #include <cstdint>
 #include <iostream>
-#include <utility>
 #include <vector>
 
 #include "cc/util/check.h"
 #include "cc/util/intcode.h"
+#include "cc/util/intcode_batch.h"
+#include "cc/util/intcode_memo.h"
 
 namespace {
 
@@ -13,10 +14,8 @@ struct Coords {
   std::int64_t y = 0;
 };
 
-bool InBeam(std::vector<std::int64_t> program, const Coords& coords) {
-  aoc2019::IntcodeMachine machine(std::move(program));
-  machine.PushInputs({coords.x, coords.y});
-  aoc2019::IntcodeMachine::RunResult result = machine.Run();
+bool InBeam(aoc2019::IntcodeMemo* program, const Coords& coords) {
+  const aoc2019::BatchResult& result = program->Run({coords.x, coords.y});
   CHECK(result.state == aoc2019::IntcodeMachine::ExecState::kHalt);
   CHECK(!result.outputs.empty());
   switch (result.outputs.front()) {
@@ -30,8 +29,7 @@ bool InBeam(std::vector<std::int64_t> program, const Coords& coords) {
   }
 }
 
-Coords NextBottomEdge(const std::vector<std::int64_t>& program,
-                      const Coords& coords) {
+Coords NextBottomEdge(aoc2019::IntcodeMemo* program, const Coords& coords) {
   Coords next{coords.x, coords.y + 1};
   while (!InBeam(program, next)) {
     ++next.x;
@@ -39,7 +37,7 @@ Coords NextBottomEdge(const std::vector<std::int64_t>& program,
   return next;
 }
 
-Coords StartPos(const std::vector<std::int64_t>& program) {
+Coords StartPos(aoc2019::IntcodeMemo* program) {
   // Find the left edge of the beam at y = 99.
   Coords start{0, 99};
   while (!InBeam(program, start)) {
@@ -48,7 +46,7 @@ Coords StartPos(const std::vector<std::int64_t>& program) {
   return start;
 }
 
-Coords FindClosest(const std::vector<std::int64_t>& program) {
+Coords FindClosest(aoc2019::IntcodeMemo* program) {
   Coords bottom_left;
   for (bottom_left = StartPos(program);
        !InBeam(program, Coords{bottom_left.x + 99, bottom_left.y - 99});
@@ -65,7 +63,8 @@ int main(int argc, char** argv) {
     return 1;
   }
   std::vector<std::int64_t> program = aoc2019::ReadIntcodeProgram(argv[1]);
-  Coords closest = FindClosest(program);
+  aoc2019::IntcodeMemo beam(program);
+  Coords closest = FindClosest(&beam);
   std::cout << (closest.x * 10000 + closest.y) << "\n";
   return 0;
 }
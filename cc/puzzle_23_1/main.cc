@@ -11,9 +11,9 @@ class Network {
  public:
   explicit Network(const std::vector<std::int64_t>& program,
                    const std::int64_t num_machines)
-      : machines_(num_machines, aoc2019::IntcodeMachine(program)) {
+      : nics_(num_machines, Nic{aoc2019::IntcodeMachine(program), {}}) {
     for (std::int64_t i = 0; i < num_machines; ++i) {
-      machines_[i].PushInputs({i});
+      nics_[i].machine.PushInputs({i});
     }
   }
 
@@ -25,44 +25,59 @@ class Network {
     } nat;
     for (;;) {
       bool idle = true;
-      for (aoc2019::IntcodeMachine& machine : machines_) {
-        aoc2019::IntcodeMachine::RunResult result = machine.Run();
-        CHECK(result.state ==
-              aoc2019::IntcodeMachine::ExecState::kPendingInput);
-        while (!result.outputs.empty()) {
+      for (Nic& nic : nics_) {
+        // Stop as soon as a packet is complete, so that it's delivered
+        // before its destination next runs.
+        aoc2019::IntcodeMachine::StopCondition stop;
+        stop.num_outputs = 3 - nic.outputs.size();
+        stop.max_instructions = kTimeSlice;
+        const aoc2019::IntcodeMachine::ExecState state =
+            nic.machine.RunUntil(stop, &nic.outputs);
+        CHECK(state != aoc2019::IntcodeMachine::ExecState::kHalt);
+        // A machine is only idle if it is waiting for input and hasn't sent
+        // anything, not even part of a packet.
+        if (state != aoc2019::IntcodeMachine::ExecState::kPendingInput ||
+            !nic.outputs.empty()) {
           idle = false;
-          std::int64_t addr = result.outputs.front();
-          result.outputs.pop_front();
-          CHECK(!result.outputs.empty());
-          std::int64_t x = result.outputs.front();
-          result.outputs.pop_front();
-          CHECK(!result.outputs.empty());
-          std::int64_t y = result.outputs.front();
-          result.outputs.pop_front();
+        }
+        // Otherwise the time slice ended partway through a packet, which is
+        // kept until the rest is sent.
+        if (nic.outputs.size() == 3) {
+          const std::int64_t addr = nic.outputs[0];
+          const std::int64_t x = nic.outputs[1];
+          const std::int64_t y = nic.outputs[2];
           if (addr == 255) {
             nat.pending_x = x;
             nat.pending_y = y;
-            continue;
-          }
-          if (addr >= 0 && addr < machines_.size()) {
-            machines_[addr].PushInputs({x, y});
+          } else if (addr >= 0 && addr < nics_.size()) {
+            nics_[addr].machine.PushInputs({x, y});
           }
+          nic.outputs.clear();
+        }
+        if (state == aoc2019::IntcodeMachine::ExecState::kPendingInput) {
+          nic.machine.PushInputs({-1});
         }
-        machine.PushInputs({-1});
       }
       if (idle) {
         if (nat.pending_y == nat.last_transmitted_y) {
           return nat.pending_y;
         }
         nat.last_transmitted_y = nat.pending_y;
-        machines_[0].PushInputs({nat.pending_x, nat.pending_y});
+        nics_[0].machine.PushInputs({nat.pending_x, nat.pending_y});
       }
     }
   }
 
  private:
+  // Instructions each machine runs before the next one gets a turn.
+  static constexpr std::uint64_t kTimeSlice = 10000;
+
+  struct Nic {
+    aoc2019::IntcodeMachine machine;
+    std::vector<std::int64_t> outputs;
+  };
 
-  std::vector<aoc2019::IntcodeMachine> machines_;
+  std::vector<Nic> nics_;
 };
 
 }  // namespace
@@ -54,7 +54,7 @@ constexpr const char* kItems[] = {
 //     1. Drops any held items.
 //     2. Picks up items indicated by the lower-order 8 bits of 'code'.
 //     3. Tries to exit the security checkpoint to the west.
-std::deque<int64_t> TryItems(std::uint32_t code) {
+std::string TryItems(std::uint32_t code) {
   std::string commands;
   for (const char* item : kItems) {
     absl::StrAppend(&commands, "drop ", item, "\n");
@@ -65,7 +65,7 @@ std::deque<int64_t> TryItems(std::uint32_t code) {
     }
   }
   absl::StrAppend(&commands, "west\n");
-  return std::deque<int64_t>(commands.begin(), commands.end());
+  return commands;
 };
 
 }  // namespace
@@ -77,13 +77,12 @@ int main(int argc, char** argv) {
   }
   aoc2019::IntcodeMachine machine(aoc2019::ReadIntcodeProgram(argv[1]));
 
-  machine.PushInputs(std::deque<std::int64_t>(
-      kCollectSequence, kCollectSequence + sizeof(kCollectSequence) - 1));
+  machine.PushAsciiInputs(kCollectSequence);
   aoc2019::IntcodeMachine::RunResult result = machine.Run();
   CHECK(result.state == aoc2019::IntcodeMachine::ExecState::kPendingInput);
 
   for (std::uint32_t itemcode = 0; itemcode < 256; ++itemcode) {
-    machine.PushInputs(TryItems(itemcode));
+    machine.PushAsciiInputs(TryItems(itemcode));
     result = machine.Run();
     if (result.state == aoc2019::IntcodeMachine::ExecState::kHalt) {
       std::cout << std::string(result.outputs.begin(), result.outputs.end());
@@ -0,0 +1,165 @@
+#include "cc/util/comma_separated.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "absl/numeric/int128.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/string_view.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define AOC2019_COMMA_SEPARATED_SSE2 1
+#endif
+
+namespace aoc2019 {
+namespace {
+
+constexpr std::size_t kBlockSize = 16;
+
+// Returns a mask with bit i set if data[i] is a comma, for i < kBlockSize.
+std::uint32_t CommaMask(const char* data) {
+#ifdef AOC2019_COMMA_SEPARATED_SSE2
+  return _mm_movemask_epi8(
+      _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)),
+                     _mm_set1_epi8(',')));
+#else
+  std::uint32_t mask = 0;
+  for (std::size_t i = 0; i < kBlockSize; ++i) {
+    if (data[i] == ',') mask |= std::uint32_t{1} << i;
+  }
+  return mask;
+#endif
+}
+
+std::size_t CountCommas(absl::string_view text) {
+  std::size_t count = 0;
+  std::size_t i = 0;
+  for (; i + kBlockSize <= text.size(); i += kBlockSize) {
+    count += __builtin_popcount(CommaMask(text.data() + i));
+  }
+  for (; i < text.size(); ++i) {
+    if (text[i] == ',') ++count;
+  }
+  return count;
+}
+
+#ifdef AOC2019_COMMA_SEPARATED_SSE2
+
+// Loading 16 bytes from kLastBytes + n gives a mask selecting the last n.
+constexpr unsigned char kLastBytes[2 * kBlockSize] = {
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+    0,    0,    0,    0,    0,    0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+// Converts the 'num_digits' (at most 16) characters before 'end', all of
+// which must be readable along with the rest of the 16 bytes before 'end'.
+// Returns false if any of them isn't a digit.
+bool ParseDigits(const char* end, int num_digits, std::int64_t* value) {
+  const __m128i chars =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(end - kBlockSize));
+  const __m128i mask = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(kLastBytes + num_digits));
+  // Bytes before the number become leading zeros.
+  const __m128i digits =
+      _mm_and_si128(_mm_sub_epi8(chars, _mm_set1_epi8('0')), mask);
+  const __m128i too_big = _mm_subs_epu8(digits, _mm_set1_epi8(9));
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(too_big, _mm_setzero_si128())) !=
+      0xffff) {
+    return false;
+  }
+
+  // Each step combines adjacent pairs of numbers, weighting the first (more
+  // significant) one by a power of 10: digits into 2-digit numbers, those
+  // into 4-digit numbers, and those into two 8-digit halves.
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i times_10 = _mm_set1_epi32(0x0001000a);
+  const __m128i pairs = _mm_packs_epi32(
+      _mm_madd_epi16(_mm_unpacklo_epi8(digits, zero), times_10),
+      _mm_madd_epi16(_mm_unpackhi_epi8(digits, zero), times_10));
+  const __m128i quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00010064));
+  const __m128i halves = _mm_madd_epi16(_mm_packs_epi32(quads, quads),
+                                        _mm_set1_epi32(0x00012710));
+  const std::int64_t high = _mm_cvtsi128_si32(halves);
+  const std::int64_t low = _mm_cvtsi128_si32(_mm_srli_si128(halves, 4));
+  *value = high * 100000000 + low;
+  return true;
+}
+
+#endif  // AOC2019_COMMA_SEPARATED_SSE2
+
+// Parses the element [begin, end) of 'text'.
+template <typename Int>
+bool ParseElement(absl::string_view text, const char* begin, const char* end,
+                  Int* value) {
+#ifdef AOC2019_COMMA_SEPARATED_SSE2
+  const bool negative = begin != end && *begin == '-';
+  const std::ptrdiff_t num_digits = end - begin - (negative ? 1 : 0);
+  constexpr auto kBlockBytes = static_cast<std::ptrdiff_t>(kBlockSize);
+  if (num_digits > 0 && num_digits <= kBlockBytes &&
+      end - text.data() >= kBlockBytes) {
+    std::int64_t parsed;
+    if (ParseDigits(end, num_digits, &parsed)) {
+      if (negative) parsed = -parsed;
+      if (parsed < std::numeric_limits<Int>::min() ||
+          parsed > std::numeric_limits<Int>::max()) {
+        return false;
+      }
+      *value = parsed;
+      return true;
+    }
+  }
+#endif
+  return absl::SimpleAtoi(absl::string_view(begin, end - begin), value);
+}
+
+template <typename Int>
+bool Parse(absl::string_view text, std::vector<Int>* values) {
+  while (!text.empty() && absl::ascii_isspace(text.back())) {
+    text.remove_suffix(1);
+  }
+  values->clear();
+  values->reserve(CountCommas(text) + 1);
+
+  const char* element = text.data();
+  const auto parse_until = [&](const char* comma) {
+    Int value;
+    if (!ParseElement(text, element, comma, &value)) return false;
+    values->push_back(value);
+    element = comma + 1;
+    return true;
+  };
+  std::size_t i = 0;
+  for (; i + kBlockSize <= text.size(); i += kBlockSize) {
+    for (std::uint32_t mask = CommaMask(text.data() + i); mask != 0;
+         mask &= mask - 1) {
+      if (!parse_until(text.data() + i + __builtin_ctz(mask))) return false;
+    }
+  }
+  for (; i < text.size(); ++i) {
+    if (text[i] == ',' && !parse_until(text.data() + i)) return false;
+  }
+  return parse_until(text.data() + text.size());
+}
+
+}  // namespace
+
+bool ParseCommaSeparatedInts(absl::string_view text,
+                             std::vector<std::int64_t>* values) {
+  return Parse(text, values);
+}
+
+bool ParseCommaSeparatedInts(absl::string_view text,
+                             std::vector<int>* values) {
+  return Parse(text, values);
+}
+
+bool ParseCommaSeparatedInts(absl::string_view text,
+                             std::vector<absl::int128>* values) {
+  return Parse(text, values);
+}
+
+}  // namespace aoc2019
@@ -0,0 +1,28 @@
+#ifndef CC_UTIL_COMMA_SEPARATED_H_
+#define CC_UTIL_COMMA_SEPARATED_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/numeric/int128.h"
+#include "absl/strings/string_view.h"
+
+namespace aoc2019 {
+
+// Parses 'text' as comma-separated integers (e.g. an Intcode program),
+// replacing the contents of '*values'. Trailing whitespace, such as the final
+// newline, is ignored. Returns false if any element isn't an integer in range,
+// leaving '*values' unspecified.
+//
+// Elements accepted by absl::SimpleAtoi() are accepted here too, but plain
+// runs of up to 16 digits, optionally negative, are converted with SSE2
+// where available, and the output is sized exactly up front.
+bool ParseCommaSeparatedInts(absl::string_view text,
+                             std::vector<std::int64_t>* values);
+bool ParseCommaSeparatedInts(absl::string_view text, std::vector<int>* values);
+bool ParseCommaSeparatedInts(absl::string_view text,
+                             std::vector<absl::int128>* values);
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_COMMA_SEPARATED_H_
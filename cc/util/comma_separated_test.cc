@@ -0,0 +1,168 @@
+// Checks ParseCommaSeparatedInts() against splitting on commas and parsing
+// each element with absl::SimpleAtoi(), on random text and on edge cases
+// around the 16-digit fast path, integer limits and malformed elements.
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/numeric/int128.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "cc/util/check.h"
+#include "cc/util/comma_separated.h"
+
+namespace aoc2019 {
+namespace {
+
+// Elements are only converted with SIMD if there are at least 16 bytes up to
+// their end, so edge cases are also checked after this.
+constexpr absl::string_view kPrefix = "0,11,222,3333,4,";
+
+template <typename Int>
+bool ReferenceParse(absl::string_view text, std::vector<Int>* values) {
+  text = absl::StripTrailingAsciiWhitespace(text);
+  values->clear();
+  for (const absl::string_view element : absl::StrSplit(text, ',')) {
+    Int value;
+    if (!absl::SimpleAtoi(element, &value)) return false;
+    values->push_back(value);
+  }
+  return true;
+}
+
+// Checks that ParseCommaSeparatedInts() accepts 'text' if and only if the
+// reference does, and if so returns the same values. Returns whether it
+// accepted 'text'.
+template <typename Int>
+bool CheckMatchesReference(absl::string_view text) {
+  std::vector<Int> expected;
+  const bool ok = ReferenceParse(text, &expected);
+  // Start with junk, which should be replaced.
+  std::vector<Int> actual = {1, 2, 3};
+  CHECK(ParseCommaSeparatedInts(text, &actual) == ok);
+  if (ok) CHECK(actual == expected);
+  return ok;
+}
+
+// Checks every overload on 'text', alone and after kPrefix.
+void CheckAllMatchReference(absl::string_view text) {
+  for (const std::string& full :
+       {std::string(text), absl::StrCat(kPrefix, text)}) {
+    CheckMatchesReference<int>(full);
+    CheckMatchesReference<std::int64_t>(full);
+    CheckMatchesReference<absl::int128>(full);
+  }
+}
+
+// Checks that the overload for 'Int' accepts 'text', alone and after kPrefix,
+// if and only if 'ok', and if so that the last value is 'value'.
+template <typename Int>
+void CheckParsesAs(absl::string_view text, bool ok, Int value = 0) {
+  for (const bool prefixed : {false, true}) {
+    const std::string full =
+        prefixed ? absl::StrCat(kPrefix, text) : std::string(text);
+    std::vector<Int> values;
+    CHECK(ParseCommaSeparatedInts(full, &values) == ok);
+    if (ok) {
+      CHECK(!values.empty());
+      CHECK(values.back() == value);
+    }
+  }
+}
+
+void TestEdgeCases() {
+  // 16 digits fit the fast path; 17 don't.
+  CheckParsesAs<std::int64_t>("1234567890123456", true, 1234567890123456);
+  CheckParsesAs<std::int64_t>("-9999999999999999", true, -9999999999999999);
+  CheckParsesAs<std::int64_t>("12345678901234567", true, 12345678901234567);
+  CheckParsesAs<std::int64_t>("-12345678901234567", true, -12345678901234567);
+  CheckParsesAs<std::int64_t>("0000000000000000000007", true, 7);
+
+  // Integer limits.
+  constexpr std::int64_t kMin64 = std::numeric_limits<std::int64_t>::min();
+  constexpr std::int64_t kMax64 = std::numeric_limits<std::int64_t>::max();
+  CheckParsesAs<std::int64_t>("-9223372036854775808", true, kMin64);
+  CheckParsesAs<std::int64_t>("9223372036854775807", true, kMax64);
+  CheckParsesAs<std::int64_t>("9223372036854775808", false);
+  CheckParsesAs<std::int64_t>("-9223372036854775809", false);
+  CheckParsesAs<int>("2147483647", true, 2147483647);
+  CheckParsesAs<int>("-2147483648", true, std::numeric_limits<int>::min());
+  CheckParsesAs<int>("2147483648", false);
+  CheckParsesAs<int>("-2147483649", false);
+  // In range for the fast path, but not for int.
+  CheckParsesAs<int>("1234567890123456", false);
+  CheckParsesAs<absl::int128>("9223372036854775808", true,
+                              absl::int128(kMax64) + 1);
+  CheckParsesAs<absl::int128>("-170141183460469231731687303715884105728",
+                              true, std::numeric_limits<absl::int128>::min());
+
+  // Malformed elements.
+  for (const absl::string_view text :
+       {"", "1,,2", ",1", "1,", "-", "--1", "1-", "12a", "0x10", "1.5"}) {
+    CheckParsesAs<int>(text, false);
+    CheckParsesAs<std::int64_t>(text, false);
+    CheckParsesAs<absl::int128>(text, false);
+  }
+
+  // Whatever absl::SimpleAtoi() accepts is accepted too.
+  CheckParsesAs<std::int64_t>("+5", true, 5);
+  CheckParsesAs<std::int64_t>("-0", true, 0);
+  CheckParsesAs<std::int64_t>("1,2\n", true, 2);
+  CheckParsesAs<std::int64_t>("1,2 \r\n\n", true, 2);
+
+  for (const absl::string_view text :
+       {"+5", "-0", "1,2\n", "1,2 \r\n\n", " 3", "3 ,4", "1234567890123456\n",
+        "-9223372036854775808,9223372036854775807\n"}) {
+    CheckAllMatchReference(text);
+  }
+}
+
+void TestRandomText() {
+  std::mt19937_64 rng(2019);
+  const auto uniform = [&rng](int low, int high) {
+    return std::uniform_int_distribution<int>(low, high)(rng);
+  };
+  // Fragments that are hard to hit by chance.
+  const std::vector<std::string> fragments = {
+      "-", "0", "+", " ", "\n", ",", "a", "00000000", "9999999999999999",
+      "1234567890123456", "12345678901234567", "-9223372036854775808",
+      "9223372036854775807", "9223372036854775808", "2147483647",
+      "2147483648", "-2147483648", "-2147483649"};
+  int num_accepted = 0;
+  for (int iteration = 0; iteration < 20000; ++iteration) {
+    std::string text;
+    const int num_elements = uniform(1, 40);
+    for (int i = 0; i < num_elements; ++i) {
+      if (i > 0) text += ',';
+      if (iteration % 2 == 1 && uniform(0, 2) == 0) {
+        text += fragments[uniform(0, fragments.size() - 1)];
+      } else {
+        // Numbers of every length, up to the full 64 bits.
+        std::int64_t value = static_cast<std::int64_t>(rng() >> uniform(0, 63));
+        if (uniform(0, 1) == 0) value = -value;
+        absl::StrAppend(&text, value);
+      }
+    }
+    if (uniform(0, 1) == 0) text += '\n';
+    num_accepted += CheckMatchesReference<std::int64_t>(text);
+    CheckMatchesReference<int>(text);
+    CheckMatchesReference<absl::int128>(text);
+  }
+  // Most of the text should be valid.
+  CHECK(num_accepted > 10000);
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  aoc2019::TestEdgeCases();
+  aoc2019::TestRandomText();
+  return 0;
+}
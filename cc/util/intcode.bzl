@@ -0,0 +1,45 @@
+"""Build rules for compiling Intcode programs ahead of time."""
+
+load("@rules_cc//cc:defs.bzl", "cc_library")
+
+def intcode_cc_library(name, program, class_name, **kwargs):
+    """Compiles an Intcode program to a C++ library.
+
+    Generates <name>.h declaring aoc2019::<class_name>, which has the same
+    Run() and PushInputs() interface as IntcodeMachine but runs 'program'
+    as native code.
+
+    Args:
+      name: Name of the generated cc_library.
+      program: Label of the comma-separated Intcode program.
+      class_name: Name of the generated class.
+      **kwargs: Passed through to the cc_library.
+    """
+    header = name + ".h"
+    source = name + ".cc"
+    include_path = header
+    if native.package_name():
+        include_path = native.package_name() + "/" + header
+    native.genrule(
+        name = name + "_transpile",
+        srcs = [program],
+        outs = [header, source],
+        cmd = "$(location //cc/util:intcode_transpiler) $(location %s) %s %s $(location %s) $(location %s)" % (
+            program,
+            class_name,
+            include_path,
+            header,
+            source,
+        ),
+        tools = ["//cc/util:intcode_transpiler"],
+    )
+    cc_library(
+        name = name,
+        hdrs = [header],
+        srcs = [source],
+        deps = [
+            "@com_google_absl//absl/base",
+            "//cc/util:intcode_transpiled",
+        ],
+        **kwargs
+    )
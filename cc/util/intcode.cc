@@ -1,23 +1,74 @@
 #include "cc/util/intcode.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <deque>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <limits>
+#include <optional>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "absl/base/optimization.h"
+#include "absl/functional/function_ref.h"
+#include "absl/numeric/int128.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_join.h"
-#include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "cc/util/check.h"
+#include "cc/util/comma_separated.h"
+#include "cc/util/intcode_bounds.h"
+#include "cc/util/intcode_image.h"
+#include "cc/util/intcode_opcodes.h"
+#include "cc/util/intcode_profile.h"
 
 namespace aoc2019 {
+namespace {
+
+// Returns the addressing modes of canonical opcode 'opcode' in base 3, as
+// in the 'kModes' that its handler is registered for.
+int ModeIndex(std::int64_t opcode) {
+  return opcode / kModeDivisors[0] % 10 +
+         3 * (opcode / kModeDivisors[1] % 10) +
+         9 * (opcode / kModeDivisors[2] % 10);
+}
+
+template <typename Word>
+bool FitsInInt64(Word word) {
+  return word >= std::numeric_limits<std::int64_t>::min() &&
+         word <= std::numeric_limits<std::int64_t>::max();
+}
+
+// Returns 'word' as an instruction. Words that don't fit in 64 bits become
+// -1, which is just as invalid.
+template <typename Word>
+std::int64_t InstructionCode(Word word) {
+  if constexpr (sizeof(Word) > sizeof(std::int64_t)) {
+    if (!FitsInInt64(word)) return -1;
+  }
+  return static_cast<std::int64_t>(word);
+}
+
+}  // namespace
+
+template <typename Word>
+std::vector<Word> ReadIntcodeProgram(const char* filename) {
+  if (const std::optional<IntcodeImage> image = IntcodeImage::Open(filename)) {
+    std::vector<Word> program;
+    program.reserve(image->words().size());
+    for (const std::int64_t word : image->words()) {
+      CHECK(word >= std::numeric_limits<Word>::min() &&
+            word <= std::numeric_limits<Word>::max());
+      program.push_back(static_cast<Word>(word));
+    }
+    return program;
+  }
 
-std::vector<std::int64_t> ReadIntcodeProgram(const char* filename) {
   std::ifstream stream(filename);
   CHECK(stream);
   std::string buffer;
@@ -27,78 +78,243 @@ std::vector<std::int64_t> ReadIntcodeProgram(const char* filename) {
   stream.read(&buffer[0], buffer.size());
   stream.close();
 
-  std::vector<std::int64_t> program;
-  for (const absl::string_view str :
-       absl::StrSplit(buffer, absl::ByChar(','))) {
-    std::int64_t element;
-    CHECK(absl::SimpleAtoi(str, &element));
-    program.push_back(element);
-  }
+  std::vector<Word> program;
+  CHECK(ParseCommaSeparatedInts(buffer, &program));
   return program;
 }
 
-IntcodeMachine::RunResult IntcodeMachine::Run() {
-  std::deque<std::int64_t> outputs;
-  for (;;) {
-    MaybeGrow(pc_);
-    switch (program_memory_[pc_] % 100) {
-      case 1:
-        Add();
-        break;
-      case 2:
-        Mul();
-        break;
-      case 3:
-        if (!Input()) {
-          return {ExecState::kPendingInput, std::move(outputs)};
-        }
-        break;
-      case 4:
-        Output(&outputs);
-        break;
-      case 5:
-        JumpIfTrue();
-        break;
-      case 6:
-        JumpIfFalse();
+IntcodeMachine::RunResult ReplayIntcode(
+    const std::vector<std::int64_t>& program,
+    absl::Span<const std::int64_t> input_log) {
+  IntcodeMachine machine(program);
+  machine.PushInputs(input_log);
+  return machine.Run();
+}
+
+template <typename Word>
+BasicIntcodeMachine<Word>::BasicIntcodeMachine(absl::Span<const Word> program)
+    : memory_(program) {
+  std::optional<std::uint64_t> bound;
+  if constexpr (std::is_same_v<Word, std::int64_t>) {
+    bound = ProveMemoryBound(program);
+  } else if (std::all_of(program.begin(), program.end(),
+                         [](const Word word) { return FitsInInt64(word); })) {
+    bound = ProveMemoryBound(
+        std::vector<std::int64_t>(program.begin(), program.end()));
+  }
+  bounded_ = bound.has_value() && memory_.ReserveTable(*bound);
+}
+
+template <typename Word>
+typename BasicIntcodeMachine<Word>::RunResult BasicIntcodeMachine<Word>::Run() {
+  RunResult result;
+  result.state = Run([&result](const Word value) {
+    result.outputs.push_back(value);
+  });
+  return result;
+}
+
+template <typename Word>
+typename BasicIntcodeMachine<Word>::ExecState BasicIntcodeMachine<Word>::Run(
+    std::vector<Word>* outputs) {
+  return Run([outputs](const Word value) { outputs->push_back(value); });
+}
+
+template <typename Word>
+typename BasicIntcodeMachine<Word>::ExecState BasicIntcodeMachine<Word>::Run(
+    OutputFn on_output) {
+  return Execute<false>(on_output, /*stop_on_output=*/false);
+}
+
+template <typename Word>
+typename BasicIntcodeMachine<Word>::ExecState BasicIntcodeMachine<Word>::RunFor(
+    const std::uint64_t max_instructions, OutputFn on_output) {
+  budget_ = max_instructions;
+  return Execute<true>(on_output, /*stop_on_output=*/false);
+}
+
+template <typename Word>
+typename BasicIntcodeMachine<Word>::ExecState BasicIntcodeMachine<Word>::RunFor(
+    const std::uint64_t max_instructions, std::vector<Word>* outputs) {
+  return RunFor(max_instructions, [outputs](const Word value) {
+    outputs->push_back(value);
+  });
+}
+
+template <typename Word>
+typename BasicIntcodeMachine<Word>::ExecState
+BasicIntcodeMachine<Word>::RunUntilOutput(Word* output) {
+  return Execute<false>([output](const Word value) { *output = value; },
+                        /*stop_on_output=*/true);
+}
+
+template <typename Word>
+typename BasicIntcodeMachine<Word>::ExecState
+BasicIntcodeMachine<Word>::RunUntilOutput(
+    Word* output, const std::uint64_t max_instructions) {
+  budget_ = max_instructions;
+  return Execute<true>([output](const Word value) { *output = value; },
+                       /*stop_on_output=*/true);
+}
+
+template <typename Word>
+typename BasicIntcodeMachine<Word>::ExecState
+BasicIntcodeMachine<Word>::RunUntil(const StopCondition& stop,
+                                    OutputFn on_output) {
+  CHECK(!stop.num_outputs.has_value() || *stop.num_outputs > 0);
+  std::uint64_t num_outputs = 0;
+  bool matched = false;
+  const auto count_output = [&](const Word value) {
+    on_output(value);
+    ++num_outputs;
+    matched = (stop.num_outputs.has_value() &&
+               num_outputs == *stop.num_outputs) ||
+              (stop.output_matches && stop.output_matches(value));
+  };
+  const bool stop_on_output =
+      stop.num_outputs.has_value() || stop.output_matches != nullptr;
+  const bool stepping = stop.pc.has_value();
+  const bool budgeted = stepping || stop.max_instructions.has_value();
+  std::uint64_t remaining = stop.max_instructions.value_or(
+      std::numeric_limits<std::uint64_t>::max());
+  for (bool first = true;; first = false) {
+    if (stepping && !first && pc_ == *stop.pc) return ExecState::kStopped;
+    if (remaining == 0) return ExecState::kBudgetExhausted;
+    ExecState state;
+    if (budgeted) {
+      const std::uint64_t slice = stepping ? 1 : remaining;
+      budget_ = slice;
+      state = Execute<true>(count_output, stop_on_output);
+      remaining -= slice - budget_;
+    } else {
+      state = Execute<false>(count_output, stop_on_output);
+    }
+    switch (state) {
+      case ExecState::kOutput:
+        if (matched) return ExecState::kOutput;
         break;
-      case 7:
-        LessThan();
+      case ExecState::kBudgetExhausted:
+        // Only the end of a single step when 'remaining' is left.
+        if (remaining == 0) return state;
         break;
-      case 8:
-        Equals();
+      default:
+        return state;
+    }
+  }
+}
+
+template <typename Word>
+typename BasicIntcodeMachine<Word>::ExecState
+BasicIntcodeMachine<Word>::RunUntil(const StopCondition& stop,
+                                    std::vector<Word>* outputs) {
+  return RunUntil(stop,
+                  [outputs](const Word value) { outputs->push_back(value); });
+}
+
+template <typename Word>
+template <bool kBudgeted, bool kTraced>
+typename BasicIntcodeMachine<Word>::ExecState
+BasicIntcodeMachine<Word>::Execute(OutputFn on_output,
+                                   const bool stop_on_output) {
+  if constexpr (!kBudgeted) {
+    budget_ = std::numeric_limits<std::uint64_t>::max();
+  }
+  for (;;) {
+    if constexpr (kBudgeted) {
+      if (budget_ == 0) return ExecState::kBudgetExhausted;
+    }
+    const DecodedInstruction* insn =
+        ABSL_PREDICT_TRUE(pc_ < decoded_.size()) ? &decoded_[pc_]
+                                                 : &FetchUncached();
+    DecodedInstruction interpreted;
+    if constexpr (kTraced) {
+      // Compiled blocks and fused handlers run several instructions, so run
+      // exactly one to trace it.
+      interpreted = Decode(pc_);
+      insn = &interpreted;
+      TraceInstruction();
+    }
+    if constexpr (kIntcodeProfile) {
+      IntcodeProfile::ForThread().CountInstruction(
+          pc_, InstructionCode(memory_.Load(pc_)));
+    }
+    switch (insn->handler(this, *insn, on_output)) {
+      case StepResult::kContinue:
+        if constexpr (kBudgeted) --budget_;
         break;
-      case 9:
-        AdjustRelativeBase();
+      case StepResult::kOutput:
+        if constexpr (kBudgeted) --budget_;
+        if (stop_on_output) return ExecState::kOutput;
         break;
-      case 99:
-        return {ExecState::kHalt, std::move(outputs)};
-      default:
-        std::cerr << "Unrecognized opcode: " << program_memory_[pc_] << "\n";
-        CHECK(false);
+      case StepResult::kPendingInput:
+        if constexpr (kTraced) trace_->DropLast();
+        if constexpr (kIntcodeProfile) {
+          IntcodeProfile& profile = IntcodeProfile::ForThread();
+          profile.UncountInstruction(pc_, InstructionCode(memory_.Load(pc_)));
+          profile.CountInputStall(pc_);
+        }
+        return ExecState::kPendingInput;
+      case StepResult::kHalt:
+        return ExecState::kHalt;
+    }
+  }
+}
+
+template <typename Word>
+void BasicIntcodeMachine<Word>::TraceInstruction() {
+  IntcodeTrace::Entry entry;
+  entry.pc = pc_;
+  entry.instruction = static_cast<std::int64_t>(memory_.Load(pc_));
+  entry.relative_base = static_cast<std::int64_t>(relative_base_);
+  std::fill_n(entry.operands, 3, 0);
+  const std::int64_t instruction = InstructionCode(memory_.Load(pc_));
+  const std::int64_t op = instruction % 100;
+  const int num_params = InstructionLength(instruction) - 1;
+  for (int param = 0; param < num_params; ++param) {
+    const Word word = memory_.Load(pc_ + 1 + param);
+    const auto mode =
+        static_cast<AddressingMode>(instruction / kModeDivisors[param] % 10);
+    if (mode == AddressingMode::kImmediate) {
+      entry.operands[param] = static_cast<std::int64_t>(word);
+      continue;
+    }
+    const std::uint64_t address =
+        mode == AddressingMode::kRelative
+            ? ParamAddress<AddressingMode::kRelative>(word)
+            : ParamAddress<AddressingMode::kAbsolute>(word);
+    if (param == StoreParam(op)) {
+      entry.operands[param] = address;
+    } else if (address < BasicIntcodeMemory<Word>::kMaxAddress) {
+      entry.operands[param] = static_cast<std::int64_t>(memory_.Load(address));
     }
   }
+  trace_->Record(entry);
 }
 
-void IntcodeMachine::RunWithConsoleIO() {
+template <typename Word>
+void BasicIntcodeMachine<Word>::RunWithConsoleIO() {
   RunResult result;
   do {
     result = Run();
-    std::cout << absl::StrJoin(result.outputs, ",") << "\n";
+    std::cout << absl::StrJoin(result.outputs, ",", absl::StreamFormatter())
+              << "\n";
     if (result.state == ExecState::kPendingInput) {
       std::cout << "INPUT> ";
-      std::int64_t input;
+      std::string input;
       std::cin >> input;
-      PushInputs({input});
+      Word value;
+      CHECK(absl::SimpleAtoi(input, &value));
+      PushInputs({value});
     }
   } while (result.state != ExecState::kHalt);
 }
 
-void IntcodeMachine::RunWithAsciiConsoleIO() {
+template <typename Word>
+void BasicIntcodeMachine<Word>::RunWithAsciiConsoleIO() {
   RunResult result;
   do {
     result = Run();
-    for (const std::int64_t val : result.outputs) {
+    for (const Word val : result.outputs) {
       if (val >= 0 && val < 128) {
         std::cout << static_cast<char>(val);
       } else {
@@ -110,145 +326,746 @@ void IntcodeMachine::RunWithAsciiConsoleIO() {
       std::string inputstr;
       std::getline(std::cin, inputstr);
       if (inputstr.back() != '\n') inputstr.push_back('\n');
-      PushInputs(std::deque<std::int64_t>(inputstr.begin(), inputstr.end()));
+      PushAsciiInputs(inputstr);
     }
   } while (result.state != ExecState::kHalt);
 }
 
-void IntcodeMachine::PushInputs(const std::deque<std::int64_t>& inputs) {
-  queued_inputs_.insert(queued_inputs_.end(), inputs.begin(), inputs.end());
+template <typename Word>
+void BasicIntcodeMachine<Word>::PushInputs(absl::Span<const Word> inputs) {
+  queued_inputs_.Append(inputs.begin(), inputs.end());
 }
 
-IntcodeMachine::AddressingMode IntcodeMachine::GetAddressingMode(
-    std::int64_t mode_field) {
-  switch (mode_field % 10) {
-    case 0:
-      return AddressingMode::kAbsolute;
-    case 1:
-      return AddressingMode::kImmediate;
-    case 2:
-      return AddressingMode::kRelative;
-    default:
-      std::cerr << "Invalid addressing mode: " << (mode_field % 10) << "\n";
-      CHECK(false);
+template <typename Word>
+void BasicIntcodeMachine<Word>::PushAsciiInputs(absl::string_view text) {
+  queued_inputs_.Append(text.begin(), text.end());
+}
+
+template <typename Word>
+void BasicIntcodeMachine<Word>::SetInputSource(
+    std::function<std::optional<Word>()> source) {
+  input_source_ = std::move(source);
+}
+
+template <typename Word>
+void BasicIntcodeMachine<Word>::Reset(const BasicIntcodeMachine& other) {
+  if (this == &other) return;
+  memory_.Reset(other.memory_);
+  bounded_ = other.bounded_;
+  if (cache_ != nullptr && cache_.use_count() == 1) {
+    // Like the memory pages, overwrite a cache this machine owns rather than
+    // sharing 'other's, so that decoding on the next run doesn't allocate.
+    cache_->decoded.assign(other.decoded_.begin(), other.decoded_.end());
+    cache_->code_marks.assign(other.code_marks_.begin(),
+                              other.code_marks_.end());
+    UpdateCacheViews();
+  } else {
+    cache_ = other.cache_;
+    decoded_ = other.decoded_;
+    code_marks_ = other.code_marks_;
   }
+  pc_ = other.pc_;
+  queued_inputs_.Assign(other.queued_inputs_);
+  input_source_ = other.input_source_;
+  relative_base_ = other.relative_base_;
+  jit_ = other.jit_;
+  trace_ = other.trace_;
+  budget_ = other.budget_;
+}
+
+template <typename Word>
+void BasicIntcodeMachine<Word>::EnableTrace(std::size_t capacity) {
+  trace_.emplace(capacity);
+}
+
+template <typename Word>
+bool BasicIntcodeMachine<Word>::EnableJit(std::uint32_t hot_threshold) {
+  if (!kJitSupported || !IntcodeJit::IsSupported()) return false;
+  if (!jit_.has_value()) jit_.emplace(hot_threshold);
+  return true;
 }
 
-void IntcodeMachine::MaybeGrow(std::vector<std::int64_t>::size_type position) {
-  if (position < program_memory_.size()) return;
-  program_memory_.resize(position + 1, 0);
+template <typename Word>
+template <bool kBounded>
+const std::vector<typename BasicIntcodeMachine<Word>::Handler>&
+BasicIntcodeMachine<Word>::DispatchTable() {
+  static const std::vector<Handler>* const table = [] {
+    std::vector<Handler> canonical(kDispatchTableSize, nullptr);
+    RegisterAllHandlers<kBounded>(&canonical,
+                                  std::make_integer_sequence<int, 27>());
+    auto* table = new std::vector<Handler>(kDispatchTableSize);
+    for (std::int64_t instruction = 0; instruction < kDispatchTableSize;
+         ++instruction) {
+      const std::int64_t opcode = CanonicalOpcode(instruction);
+      (*table)[instruction] =
+          opcode < 0 ? &Invoke<&BasicIntcodeMachine::IllegalInstruction>
+                     : canonical[opcode];
+    }
+    return table;
+  }();
+  return *table;
 }
 
-std::int64_t IntcodeMachine::LoadParam(std::int64_t mode, std::int64_t value) {
-  switch (GetAddressingMode(mode)) {
-    case AddressingMode::kAbsolute:
-      MaybeGrow(value);
-      return program_memory_[value];
-    case AddressingMode::kImmediate:
-      return value;
-    case AddressingMode::kRelative: {
-      const std::vector<std::int64_t>::size_type position =
-          relative_base_ + value;
-      MaybeGrow(position);
-      return program_memory_[position];
+template <typename Word>
+std::int64_t BasicIntcodeMachine<Word>::CanonicalOpcode(
+    std::int64_t instruction) {
+  if (instruction < 0) return -1;
+  const std::int64_t op = instruction % 100;
+  const int num_params = ParamCount(op);
+  if (num_params < 0) return -1;
+  std::int64_t canonical = op;
+  for (int param = 0; param < num_params; ++param) {
+    const std::int64_t mode = instruction / kModeDivisors[param] % 10;
+    if (mode > 2) return -1;
+    if (param == StoreParam(op) &&
+        mode == static_cast<std::int64_t>(AddressingMode::kImmediate)) {
+      return -1;
     }
+    canonical += mode * kModeDivisors[param];
   }
-  CHECK(false);
+  return canonical;
 }
 
-void IntcodeMachine::Store(std::int64_t mode, std::int64_t value,
-                           std::int64_t position) {
-  switch (GetAddressingMode(mode)) {
-    case AddressingMode::kAbsolute:
-      MaybeGrow(position);
-      program_memory_[position] = value;
-      return;
-    case AddressingMode::kImmediate:
-      std::cerr << "Can't store with immediate mode destination\n";
-      CHECK(false);
-    case AddressingMode::kRelative:
-      position += relative_base_;
-      MaybeGrow(position);
-      program_memory_[position] = value;
-      return;
+template <typename Word>
+std::uint64_t BasicIntcodeMachine<Word>::ToAddress(const Word word) {
+  if constexpr (sizeof(Word) > sizeof(std::int64_t)) {
+    if (!FitsInInt64(word)) return BasicIntcodeMemory<Word>::kMaxAddress;
   }
+  return static_cast<std::uint64_t>(word);
 }
 
-template <typename Op>
-void IntcodeMachine::Math3() {
-  MaybeGrow(pc_ + 3);
-  const std::int64_t opcode = program_memory_[pc_++];
-  const std::int64_t param0 = LoadParam(opcode / 100, program_memory_[pc_++]);
-  const std::int64_t param1 = LoadParam(opcode / 1000,
-                                        program_memory_[pc_++]);
-  const std::int64_t result = Op()(param0, param1);
-  Store(opcode / 10000, result, program_memory_[pc_++]);
+template <typename Word>
+template <bool kBounded, int kModes>
+void BasicIntcodeMachine<Word>::RegisterHandlersForModes(
+    std::vector<Handler>* canonical) {
+  constexpr AddressingMode m0 = static_cast<AddressingMode>(kModes % 3);
+  constexpr AddressingMode m1 = static_cast<AddressingMode>(kModes / 3 % 3);
+  constexpr AddressingMode m2 = static_cast<AddressingMode>(kModes / 9);
+  constexpr std::int64_t modes = kModeDivisors[0] * (kModes % 3) +
+                                 kModeDivisors[1] * (kModes / 3 % 3) +
+                                 kModeDivisors[2] * (kModes / 9);
+  if constexpr (m2 != AddressingMode::kImmediate) {
+    (*canonical)[1 + modes] =
+        &Invoke<&BasicIntcodeMachine::Add<kBounded, m0, m1, m2>>;
+    (*canonical)[2 + modes] =
+        &Invoke<&BasicIntcodeMachine::Mul<kBounded, m0, m1, m2>>;
+    (*canonical)[7 + modes] =
+        &Invoke<&BasicIntcodeMachine::LessThan<kBounded, m0, m1, m2>>;
+    (*canonical)[8 + modes] =
+        &Invoke<&BasicIntcodeMachine::Equals<kBounded, m0, m1, m2>>;
+  }
+  if constexpr (m2 == AddressingMode::kAbsolute) {
+    (*canonical)[5 + modes] =
+        &Invoke<&BasicIntcodeMachine::JumpIfTrue<kBounded, m0, m1>>;
+    (*canonical)[6 + modes] =
+        &Invoke<&BasicIntcodeMachine::JumpIfFalse<kBounded, m0, m1>>;
+  }
+  if constexpr (m1 == AddressingMode::kAbsolute &&
+                m2 == AddressingMode::kAbsolute) {
+    if constexpr (m0 != AddressingMode::kImmediate) {
+      (*canonical)[3 + modes] = &Invoke<&BasicIntcodeMachine::Input<m0>>;
+    }
+    (*canonical)[4 + modes] =
+        &Invoke<&BasicIntcodeMachine::Output<kBounded, m0>>;
+    (*canonical)[9 + modes] =
+        &Invoke<&BasicIntcodeMachine::AdjustRelativeBase<kBounded, m0>>;
+  }
+  if constexpr (kModes == 0) {
+    (*canonical)[99] = &Invoke<&BasicIntcodeMachine::Halt>;
+  }
 }
 
-void IntcodeMachine::Add() {
-  Math3<std::plus<std::int64_t>>();
+template <typename Word>
+template <bool kBounded>
+const typename BasicIntcodeMachine<Word>::FusedHandlers&
+BasicIntcodeMachine<Word>::FusedHandlerTable() {
+  static const FusedHandlers* const table = [] {
+    auto* table = new FusedHandlers;
+    RegisterAllFusedHandlers<kBounded>(table,
+                                       std::make_integer_sequence<int, 27>());
+    return table;
+  }();
+  return *table;
 }
 
-void IntcodeMachine::Mul() {
-  Math3<std::multiplies<std::int64_t>>();
+template <typename Word>
+template <bool kBounded, int kModes>
+void BasicIntcodeMachine<Word>::RegisterFusedHandlersForModes(
+    FusedHandlers* fused) {
+  constexpr AddressingMode m0 = static_cast<AddressingMode>(kModes % 3);
+  constexpr AddressingMode m1 = static_cast<AddressingMode>(kModes / 3 % 3);
+  constexpr AddressingMode m2 = static_cast<AddressingMode>(kModes / 9);
+  if constexpr (m2 != AddressingMode::kImmediate) {
+    fused->compare_and_branch[0][0][kModes] = &Invoke<
+        &BasicIntcodeMachine::CompareAndBranch<kBounded, std::less<Word>,
+                                               false, m0, m1, m2>>;
+    fused->compare_and_branch[0][1][kModes] = &Invoke<
+        &BasicIntcodeMachine::CompareAndBranch<kBounded, std::less<Word>,
+                                               true, m0, m1, m2>>;
+    fused->compare_and_branch[1][0][kModes] = &Invoke<
+        &BasicIntcodeMachine::CompareAndBranch<kBounded, std::equal_to<Word>,
+                                               false, m0, m1, m2>>;
+    fused->compare_and_branch[1][1][kModes] = &Invoke<
+        &BasicIntcodeMachine::CompareAndBranch<kBounded, std::equal_to<Word>,
+                                               true, m0, m1, m2>>;
+    fused->add_then_jump[0][kModes] =
+        &Invoke<&BasicIntcodeMachine::AddThenJump<kBounded, false, m0, m1, m2>>;
+    fused->add_then_jump[1][kModes] =
+        &Invoke<&BasicIntcodeMachine::AddThenJump<kBounded, true, m0, m1, m2>>;
+    fused->adjust_then_add[kModes] = &Invoke<
+        &BasicIntcodeMachine::AdjustRelativeBaseThenAdd<kBounded, m0, m1, m2>>;
+  }
+  if constexpr (kModes == 0) {
+    fused->adjust_then_jump[0] = &Invoke<
+        &BasicIntcodeMachine::AdjustRelativeBaseThenJump<kBounded, false>>;
+    fused->adjust_then_jump[1] = &Invoke<
+        &BasicIntcodeMachine::AdjustRelativeBaseThenJump<kBounded, true>>;
+  }
 }
 
-bool IntcodeMachine::Input() {
-  if (queued_inputs_.empty()) return false;
-  MaybeGrow(pc_ + 1);
-  const std::int64_t value = queued_inputs_.front();
-  queued_inputs_.pop_front();
-  const std::int64_t mode = program_memory_[pc_++] / 100;
-  Store(mode, value, program_memory_[pc_++]);
-  return true;
+template <typename Word>
+const typename BasicIntcodeMachine<Word>::DecodedInstruction&
+BasicIntcodeMachine<Word>::FetchUncached() {
+  static const DecodedInstruction kUndecoded;
+  if (pc_ >= kMaxCachedPc) return kUndecoded;
+  MutableCache().decoded.resize(
+      (pc_ | (BasicIntcodeMemory<Word>::kPageSize - 1)) + 1);
+  UpdateCacheViews();
+  return decoded_[pc_];
 }
 
-void IntcodeMachine::Output(std::deque<std::int64_t>* outputs) {
-  MaybeGrow(pc_ + 1);
-  const std::int64_t mode = program_memory_[pc_++] / 100;
-  const std::int64_t value = LoadParam(mode, program_memory_[pc_++]);
-  outputs->push_back(value);
+template <typename Word>
+typename BasicIntcodeMachine<Word>::DecodedInstruction
+BasicIntcodeMachine<Word>::Decode(const std::uint64_t pc) const {
+  const std::int64_t instruction = InstructionCode(memory_.Load(pc));
+
+  DecodedInstruction decoded;
+  const std::vector<Handler>& dispatch =
+      bounded_ ? DispatchTable<true>() : DispatchTable<false>();
+  if (ABSL_PREDICT_TRUE(instruction >= 0 &&
+                        instruction < kDispatchTableSize)) {
+    decoded.handler = dispatch[instruction];
+  } else {
+    const std::int64_t opcode = CanonicalOpcode(instruction);
+    decoded.handler = opcode < 0
+                          ? &Invoke<&BasicIntcodeMachine::IllegalInstruction>
+                          : dispatch[opcode];
+  }
+  const int num_params = InstructionLength(instruction) - 1;
+  for (int param = 0; param < num_params; ++param) {
+    decoded.params[param] = memory_.Load(pc + 1 + param);
+  }
+  return decoded;
+}
+
+template <typename Word>
+void BasicIntcodeMachine<Word>::CacheInstruction(
+    const std::uint64_t pc, const DecodedInstruction& decoded) {
+  DecodeCache& cache = MutableCache();
+  cache.decoded[pc] = decoded;
+  const int length = InstructionLength(InstructionCode(memory_.Load(pc)));
+  if (cache.code_marks.size() < pc + length) {
+    cache.code_marks.resize(std::max(pc + length, cache.decoded.size()), 0);
+    UpdateCacheViews();
+  }
+  std::fill_n(cache.code_marks.begin() + pc, length, 1);
+}
+
+template <typename Word>
+typename BasicIntcodeMachine<Word>::DecodeCache&
+BasicIntcodeMachine<Word>::MutableCache() {
+  if (cache_ == nullptr) {
+    cache_ = std::make_shared<DecodeCache>();
+  } else if (cache_.use_count() > 1) {
+    cache_ = std::make_shared<DecodeCache>(*cache_);
+  } else {
+    // Every other machine sharing the cache is gone, so it can be modified
+    // in place.
+    return *cache_;
+  }
+  UpdateCacheViews();
+  return *cache_;
 }
 
-template <bool if_true>
-void IntcodeMachine::ConditionalJump() {
-  MaybeGrow(pc_ + 2);
-  const std::int64_t opcode = program_memory_[pc_++];
-  const std::int64_t value = LoadParam(opcode / 100, program_memory_[pc_++]);
+template <typename Word>
+void BasicIntcodeMachine<Word>::UpdateCacheViews() {
+  decoded_ = cache_->decoded;
+  code_marks_ = cache_->code_marks;
+}
+
+template <typename Word>
+void BasicIntcodeMachine<Word>::Fuse(const std::uint64_t pc) {
+  const std::int64_t first =
+      CanonicalOpcode(InstructionCode(memory_.Load(pc)));
+  const std::int64_t op = first % 100;
+  if (op != 1 && op != 7 && op != 8 && first != 109) return;
+  const std::uint64_t next = pc + InstructionLength(first);
+  if (next >= decoded_.size()) return;
+  const std::int64_t second =
+      CanonicalOpcode(InstructionCode(memory_.Load(next)));
+  const std::int64_t next_op = second % 100;
+  if (next_op != 1 && next_op != 5 && next_op != 6) return;
+  if (decoded_[next].handler == &DecodeAndExecute) {
+    CacheInstruction(next, Decode(next));
+  }
+
+  const FusedHandlers& fused =
+      bounded_ ? FusedHandlerTable<true>() : FusedHandlerTable<false>();
+  const Word* const params = decoded_[pc].params;
+  const Word* const next_params = decoded_[next].params;
+  const bool if_true = next_op == 5;
+  // Unconditional jumps have an immediate condition and target.
+  const bool jumps = (second == 1105 || second == 1106) &&
+                     (next_params[0] != 0) == if_true;
+  Handler handler = nullptr;
+  if (next_op == 1) {
+    if (first == 109) handler = fused.adjust_then_add[ModeIndex(second)];
+  } else if (op == 7 || op == 8) {
+    // The jump must test the compare's result and have an immediate target.
+    if (second / kModeDivisors[0] % 10 == first / kModeDivisors[2] % 10 &&
+        second / kModeDivisors[1] % 10 == 1 && next_params[0] == params[2]) {
+      handler = fused.compare_and_branch[op == 8][if_true][ModeIndex(first)];
+    }
+  } else if (jumps) {
+    handler = op == 1 ? fused.add_then_jump[if_true][ModeIndex(first)]
+                      : fused.adjust_then_jump[if_true];
+  }
+  if (handler != nullptr) MutableCache().decoded[pc].handler = handler;
+}
+
+template <typename Word>
+typename BasicIntcodeMachine<Word>::StepResult
+BasicIntcodeMachine<Word>::DecodeAndExecute(BasicIntcodeMachine* machine,
+                                            const DecodedInstruction& /*insn*/,
+                                            OutputFn outputs) {
+  const DecodedInstruction decoded = machine->Decode(machine->pc_);
+  const std::vector<std::int64_t>::size_type pc = machine->pc_;
+  if (pc < machine->decoded_.size()) {
+    machine->CacheInstruction(pc, decoded);
+    machine->Fuse(pc);
+  }
+  return decoded.handler(machine, decoded, outputs);
+}
+
+template <typename Word>
+typename BasicIntcodeMachine<Word>::StepResult
+BasicIntcodeMachine<Word>::EnterJitBlock(BasicIntcodeMachine* machine,
+                                         const DecodedInstruction& insn,
+                                         OutputFn outputs) {
+  if constexpr (!kJitSupported) {
+    // Never installed, since EnableJit() fails.
+    return DecodeAndExecute(machine, insn, outputs);
+  } else {
+    if (!machine->jit_.has_value() ||
+        static_cast<std::uint64_t>(insn.params[1]) != machine->jit_->id()) {
+      // Left over from the machine this one was copied from.
+      return DecodeAndExecute(machine, insn, outputs);
+    }
+    const int index = insn.params[0];
+    const IntcodeJit::Block& block = machine->jit_->block(index);
+    if (machine->budget_ < block.length) {
+      // A full pass through the block might overrun the budget.
+      const DecodedInstruction decoded = machine->Decode(machine->pc_);
+      return decoded.handler(machine, decoded, outputs);
+    }
+    IntcodeJit::Context context;
+    context.pages = machine->memory_.page_table();
+    context.num_pages = machine->memory_.num_pages();
+    context.relative_base = machine->relative_base_;
+    context.code_marks = machine->code_marks_.data();
+    context.code_marks_size = machine->code_marks_.size();
+    context.bailed_out = 0;
+    context.budget = machine->budget_ - block.length;
+    const std::uint64_t next_pc = block.fn(&context);
+    machine->relative_base_ = context.relative_base;
+    const std::uint64_t executed = machine->budget_ - block.length -
+                                   context.budget + context.partial_pass;
+    machine->budget_ -= executed;
+
+    if (context.bailed_out != 0 && next_pc == machine->pc_) {
+      // The first instruction couldn't run natively (it needs to grow memory
+      // or is about to modify code), so interpret it.
+      if (machine->jit_->NoteStall(index)) {
+        machine->MutableCache().decoded[machine->pc_].handler =
+            &DecodeAndExecute;
+      }
+      const DecodedInstruction decoded = machine->Decode(machine->pc_);
+      return decoded.handler(machine, decoded, outputs);
+    }
+
+    if constexpr (kIntcodeProfile) {
+      // Execute() counted the first instruction as interpreted.
+      IntcodeProfile& profile = IntcodeProfile::ForThread();
+      profile.UncountInstruction(machine->pc_,
+                                 machine->memory_.Load(machine->pc_));
+      profile.CountJitBlock(machine->pc_, executed);
+    }
+
+    // Execute() counts this call as one more instruction.
+    machine->budget_ += 1;
+    machine->jit_->NoteProgress(index, executed);
+    machine->pc_ = next_pc;
+    if (context.bailed_out == 0) machine->NoteJumpTarget();
+    return StepResult::kContinue;
+  }
+}
+
+template <typename Word>
+void BasicIntcodeMachine<Word>::NoteJumpTarget() {
+  if constexpr (kJitSupported) {
+    if (!jit_->NoteEntry(pc_)) return;
+    const int index = jit_->Compile(memory_, pc_);
+    if (index < 0) return;
+
+    DecodeCache& cache = MutableCache();
+    for (const auto& [begin, end] : jit_->block(index).spans) {
+      if (cache.code_marks.size() < end) cache.code_marks.resize(end, 0);
+      std::fill(cache.code_marks.begin() + begin,
+                cache.code_marks.begin() + end, 1);
+    }
+    if (cache.decoded.size() <= pc_) {
+      cache.decoded.resize((pc_ | (IntcodeMemory::kPageSize - 1)) + 1);
+    }
+    UpdateCacheViews();
+    DecodedInstruction& entry = cache.decoded[pc_];
+    entry.handler = &EnterJitBlock;
+    entry.params[0] = index;
+    entry.params[1] = jit_->id();
+  }
+}
+
+template <typename Word>
+void BasicIntcodeMachine<Word>::InvalidateCode(
+    std::vector<std::int64_t>::size_type position) {
+  DecodeCache& cache = MutableCache();
+  cache.code_marks[position] = 0;
+  // Fused pairs of instructions are at most 7 words long, so only the ones
+  // starting in the 6 words before 'position' (or at it) can cover it.
+  const std::vector<std::int64_t>::size_type first =
+      position < 6 ? 0 : position - 6;
+  const std::vector<std::int64_t>::size_type last =
+      std::min(position + 1, cache.decoded.size());
+  for (std::vector<std::int64_t>::size_type pc = first; pc < last; ++pc) {
+    cache.decoded[pc].handler = &DecodeAndExecute;
+  }
+  if (jit_.has_value()) {
+    jit_->InvalidateCovering(position, [&cache](std::uint64_t start) {
+      if (start < cache.decoded.size() &&
+          cache.decoded[start].handler == &EnterJitBlock) {
+        cache.decoded[start].handler = &DecodeAndExecute;
+      }
+    });
+  }
+}
+
+template <typename Word>
+template <typename BasicIntcodeMachine<Word>::AddressingMode mode>
+std::uint64_t BasicIntcodeMachine<Word>::ParamAddress(const Word value) const {
+  if constexpr (sizeof(Word) > sizeof(std::int64_t)) {
+    return ToAddress(mode == AddressingMode::kRelative ? value + relative_base_
+                                                       : value);
+  } else {
+    // Wraps around just like 64-bit addition, without the overflow.
+    std::uint64_t address = static_cast<std::uint64_t>(value);
+    if constexpr (mode == AddressingMode::kRelative) {
+      address += static_cast<std::uint64_t>(relative_base_);
+    }
+    return address;
+  }
+}
+
+template <typename Word>
+template <bool kBounded,
+          typename BasicIntcodeMachine<Word>::AddressingMode mode>
+Word BasicIntcodeMachine<Word>::LoadParam(const Word value) {
+  if constexpr (mode == AddressingMode::kImmediate) {
+    return value;
+  } else {
+    const std::uint64_t address = ParamAddress<mode>(value);
+    if constexpr (kBounded) {
+      return memory_.LoadUnchecked(address);
+    } else {
+      return memory_.Load(address);
+    }
+  }
+}
+
+template <typename Word>
+template <typename BasicIntcodeMachine<Word>::AddressingMode mode>
+void BasicIntcodeMachine<Word>::Store(const Word value, const Word position) {
+  static_assert(mode != AddressingMode::kImmediate,
+                "Can't store with immediate mode destination");
+  const std::uint64_t address = ParamAddress<mode>(position);
+  memory_.Store(address, value);
+  if (ABSL_PREDICT_FALSE(address < code_marks_.size() &&
+                         code_marks_[address] != 0)) {
+    InvalidateCode(address);
+  }
+}
+
+template <typename Word>
+template <bool kBounded, typename Op,
+          typename BasicIntcodeMachine<Word>::AddressingMode in0,
+          typename BasicIntcodeMachine<Word>::AddressingMode in1,
+          typename BasicIntcodeMachine<Word>::AddressingMode out>
+typename BasicIntcodeMachine<Word>::StepResult BasicIntcodeMachine<Word>::Math3(
+    const DecodedInstruction& insn) {
+  const Word param0 = LoadParam<kBounded, in0>(insn.params[0]);
+  const Word param1 = LoadParam<kBounded, in1>(insn.params[1]);
+  pc_ += 4;
+  Store<out>(Op()(param0, param1), insn.params[2]);
+  return StepResult::kContinue;
+}
+
+template <typename Word>
+template <bool kBounded, typename BasicIntcodeMachine<Word>::AddressingMode in0,
+          typename BasicIntcodeMachine<Word>::AddressingMode in1,
+          typename BasicIntcodeMachine<Word>::AddressingMode out>
+typename BasicIntcodeMachine<Word>::StepResult BasicIntcodeMachine<Word>::Add(
+    const DecodedInstruction& insn, OutputFn /*outputs*/) {
+  return Math3<kBounded, std::plus<Word>, in0, in1, out>(insn);
+}
+
+template <typename Word>
+template <bool kBounded, typename BasicIntcodeMachine<Word>::AddressingMode in0,
+          typename BasicIntcodeMachine<Word>::AddressingMode in1,
+          typename BasicIntcodeMachine<Word>::AddressingMode out>
+typename BasicIntcodeMachine<Word>::StepResult BasicIntcodeMachine<Word>::Mul(
+    const DecodedInstruction& insn, OutputFn /*outputs*/) {
+  return Math3<kBounded, std::multiplies<Word>, in0, in1, out>(insn);
+}
+
+template <typename Word>
+template <typename BasicIntcodeMachine<Word>::AddressingMode out>
+typename BasicIntcodeMachine<Word>::StepResult BasicIntcodeMachine<Word>::Input(
+    const DecodedInstruction& insn, OutputFn /*outputs*/) {
+  Word value;
+  if (ABSL_PREDICT_TRUE(!queued_inputs_.empty())) {
+    value = queued_inputs_.front();
+    queued_inputs_.pop_front();
+  } else {
+    if (!input_source_) return StepResult::kPendingInput;
+    const std::optional<Word> pulled = input_source_();
+    if (!pulled.has_value()) return StepResult::kPendingInput;
+    value = *pulled;
+  }
+  if (ABSL_PREDICT_FALSE(trace_.has_value())) {
+    trace_->LogInput(static_cast<std::int64_t>(value));
+  }
+  pc_ += 2;
+  Store<out>(value, insn.params[0]);
+  return StepResult::kContinue;
+}
+
+template <typename Word>
+template <bool kBounded, typename BasicIntcodeMachine<Word>::AddressingMode in>
+typename BasicIntcodeMachine<Word>::StepResult
+BasicIntcodeMachine<Word>::Output(const DecodedInstruction& insn,
+                                  OutputFn outputs) {
+  outputs(LoadParam<kBounded, in>(insn.params[0]));
+  pc_ += 2;
+  return StepResult::kOutput;
+}
+
+template <typename Word>
+template <bool kBounded, bool if_true,
+          typename BasicIntcodeMachine<Word>::AddressingMode in0,
+          typename BasicIntcodeMachine<Word>::AddressingMode in1>
+typename BasicIntcodeMachine<Word>::StepResult
+BasicIntcodeMachine<Word>::ConditionalJump(const DecodedInstruction& insn) {
+  const Word value = LoadParam<kBounded, in0>(insn.params[0]);
   if constexpr (if_true) {
     if (value == 0) {
-      ++pc_;
-      return;
+      pc_ += 3;
+      return StepResult::kContinue;
     }
   } else {
     if (value != 0) {
-      ++pc_;
-      return;
+      pc_ += 3;
+      return StepResult::kContinue;
     }
   }
-  pc_ = LoadParam(opcode / 1000, program_memory_[pc_]);
+  pc_ = ToAddress(LoadParam<kBounded, in1>(insn.params[1]));
+  if (ABSL_PREDICT_FALSE(jit_.has_value())) NoteJumpTarget();
+  return StepResult::kContinue;
+}
+
+template <typename Word>
+template <bool kBounded, typename BasicIntcodeMachine<Word>::AddressingMode in0,
+          typename BasicIntcodeMachine<Word>::AddressingMode in1>
+typename BasicIntcodeMachine<Word>::StepResult
+BasicIntcodeMachine<Word>::JumpIfTrue(const DecodedInstruction& insn,
+                                      OutputFn /*outputs*/) {
+  return ConditionalJump<kBounded, true, in0, in1>(insn);
+}
+
+template <typename Word>
+template <bool kBounded, typename BasicIntcodeMachine<Word>::AddressingMode in0,
+          typename BasicIntcodeMachine<Word>::AddressingMode in1>
+typename BasicIntcodeMachine<Word>::StepResult
+BasicIntcodeMachine<Word>::JumpIfFalse(const DecodedInstruction& insn,
+                                       OutputFn /*outputs*/) {
+  return ConditionalJump<kBounded, false, in0, in1>(insn);
+}
+
+template <typename Word>
+template <bool kBounded, typename BasicIntcodeMachine<Word>::AddressingMode in0,
+          typename BasicIntcodeMachine<Word>::AddressingMode in1,
+          typename BasicIntcodeMachine<Word>::AddressingMode out>
+typename BasicIntcodeMachine<Word>::StepResult
+BasicIntcodeMachine<Word>::LessThan(const DecodedInstruction& insn,
+                                    OutputFn /*outputs*/) {
+  return Math3<kBounded, std::less<Word>, in0, in1, out>(insn);
+}
+
+template <typename Word>
+template <bool kBounded, typename BasicIntcodeMachine<Word>::AddressingMode in0,
+          typename BasicIntcodeMachine<Word>::AddressingMode in1,
+          typename BasicIntcodeMachine<Word>::AddressingMode out>
+typename BasicIntcodeMachine<Word>::StepResult
+BasicIntcodeMachine<Word>::Equals(const DecodedInstruction& insn,
+                                  OutputFn /*outputs*/) {
+  return Math3<kBounded, std::equal_to<Word>, in0, in1, out>(insn);
+}
+
+template <typename Word>
+template <bool kBounded, typename BasicIntcodeMachine<Word>::AddressingMode in>
+typename BasicIntcodeMachine<Word>::StepResult
+BasicIntcodeMachine<Word>::AdjustRelativeBase(const DecodedInstruction& insn,
+                                              OutputFn /*outputs*/) {
+  relative_base_ += LoadParam<kBounded, in>(insn.params[0]);
+  pc_ += 2;
+  return StepResult::kContinue;
+}
+
+template <typename Word>
+bool BasicIntcodeMachine<Word>::ContinueFused(const Handler expected) {
+  if (ABSL_PREDICT_FALSE(budget_ < 2 || decoded_[pc_].handler != expected)) {
+    return false;
+  }
+  --budget_;
+  if constexpr (kIntcodeProfile) {
+    IntcodeProfile& profile = IntcodeProfile::ForThread();
+    profile.CountInstruction(pc_, InstructionCode(memory_.Load(pc_)));
+    profile.CountFusedPair();
+  }
+  return true;
 }
 
-void IntcodeMachine::JumpIfTrue() {
-  ConditionalJump<true>();
+template <typename Word>
+template <bool kBounded, typename Compare, bool if_true,
+          typename BasicIntcodeMachine<Word>::AddressingMode in0,
+          typename BasicIntcodeMachine<Word>::AddressingMode in1,
+          typename BasicIntcodeMachine<Word>::AddressingMode out>
+typename BasicIntcodeMachine<Word>::StepResult
+BasicIntcodeMachine<Word>::CompareAndBranch(const DecodedInstruction& insn,
+                                            OutputFn /*outputs*/) {
+  const bool result = Compare()(LoadParam<kBounded, in0>(insn.params[0]),
+                                LoadParam<kBounded, in1>(insn.params[1]));
+  pc_ += 4;
+  Store<out>(result, insn.params[2]);
+  if (!ContinueFused(
+          JumpHandler<kBounded, if_true, out, AddressingMode::kImmediate>())) {
+    return StepResult::kContinue;
+  }
+  if (result != if_true) {
+    pc_ += 3;
+    return StepResult::kContinue;
+  }
+  pc_ = ToAddress(decoded_[pc_].params[1]);
+  if (ABSL_PREDICT_FALSE(jit_.has_value())) NoteJumpTarget();
+  return StepResult::kContinue;
 }
 
-void IntcodeMachine::JumpIfFalse() {
-  ConditionalJump<false>();
+template <typename Word>
+template <bool kBounded, bool if_true,
+          typename BasicIntcodeMachine<Word>::AddressingMode in0,
+          typename BasicIntcodeMachine<Word>::AddressingMode in1,
+          typename BasicIntcodeMachine<Word>::AddressingMode out>
+typename BasicIntcodeMachine<Word>::StepResult
+BasicIntcodeMachine<Word>::AddThenJump(const DecodedInstruction& insn,
+                                       OutputFn /*outputs*/) {
+  Math3<kBounded, std::plus<Word>, in0, in1, out>(insn);
+  if (ContinueFused(JumpHandler<kBounded, if_true, AddressingMode::kImmediate,
+                                AddressingMode::kImmediate>())) {
+    pc_ = ToAddress(decoded_[pc_].params[1]);
+    if (ABSL_PREDICT_FALSE(jit_.has_value())) NoteJumpTarget();
+  }
+  return StepResult::kContinue;
 }
 
-void IntcodeMachine::LessThan() {
-  Math3<std::less<std::int64_t>>();
+template <typename Word>
+template <bool kBounded, bool if_true>
+typename BasicIntcodeMachine<Word>::StepResult
+BasicIntcodeMachine<Word>::AdjustRelativeBaseThenJump(
+    const DecodedInstruction& insn, OutputFn /*outputs*/) {
+  relative_base_ += insn.params[0];
+  pc_ += 2;
+  if (ContinueFused(JumpHandler<kBounded, if_true, AddressingMode::kImmediate,
+                                AddressingMode::kImmediate>())) {
+    pc_ = ToAddress(decoded_[pc_].params[1]);
+    if (ABSL_PREDICT_FALSE(jit_.has_value())) NoteJumpTarget();
+  }
+  return StepResult::kContinue;
 }
 
-void IntcodeMachine::Equals() {
-  Math3<std::equal_to<std::int64_t>>();
+template <typename Word>
+template <bool kBounded, typename BasicIntcodeMachine<Word>::AddressingMode in0,
+          typename BasicIntcodeMachine<Word>::AddressingMode in1,
+          typename BasicIntcodeMachine<Word>::AddressingMode out>
+typename BasicIntcodeMachine<Word>::StepResult
+BasicIntcodeMachine<Word>::AdjustRelativeBaseThenAdd(
+    const DecodedInstruction& insn, OutputFn /*outputs*/) {
+  relative_base_ += insn.params[0];
+  pc_ += 2;
+  if (!ContinueFused(
+          &Invoke<&BasicIntcodeMachine::Add<kBounded, in0, in1, out>>)) {
+    return StepResult::kContinue;
+  }
+  return Math3<kBounded, std::plus<Word>, in0, in1, out>(decoded_[pc_]);
 }
 
-void IntcodeMachine::AdjustRelativeBase() {
-  MaybeGrow(pc_ + 1);
-  const std::int64_t mode = program_memory_[pc_++] / 100;
-  relative_base_ += LoadParam(mode, program_memory_[pc_++]);
+template <typename Word>
+typename BasicIntcodeMachine<Word>::StepResult BasicIntcodeMachine<Word>::Halt(
+    const DecodedInstruction& /*insn*/, OutputFn /*outputs*/) {
+  return StepResult::kHalt;
 }
 
+template <typename Word>
+typename BasicIntcodeMachine<Word>::StepResult
+BasicIntcodeMachine<Word>::IllegalInstruction(
+    const DecodedInstruction& /*insn*/, OutputFn /*outputs*/) {
+  const std::int64_t instruction = InstructionCode(memory_.Load(pc_));
+  const std::int64_t op = instruction % 100;
+  const int num_params = instruction < 0 ? -1 : ParamCount(op);
+  if (num_params < 0) {
+    std::cerr << "Unrecognized opcode: " << memory_.Load(pc_) << "\n";
+    CHECK(false);
+  }
+  for (int param = 0; param < num_params; ++param) {
+    const std::int64_t mode = instruction / kModeDivisors[param] % 10;
+    if (mode > 2) {
+      std::cerr << "Invalid addressing mode: " << mode << "\n";
+      CHECK(false);
+    }
+    if (param == StoreParam(op) &&
+        mode == static_cast<std::int64_t>(AddressingMode::kImmediate)) {
+      std::cerr << "Can't store with immediate mode destination\n";
+      CHECK(false);
+    }
+  }
+  CHECK(false);
+}
+
+template class BasicIntcodeMachine<std::int32_t>;
+template class BasicIntcodeMachine<std::int64_t>;
+template class BasicIntcodeMachine<absl::int128>;
+
+template std::vector<std::int32_t> ReadIntcodeProgram<std::int32_t>(
+    const char* filename);
+template std::vector<std::int64_t> ReadIntcodeProgram<std::int64_t>(
+    const char* filename);
+template std::vector<absl::int128> ReadIntcodeProgram<absl::int128>(
+    const char* filename);
+
 }  // namespace aoc2019
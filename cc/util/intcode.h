@@ -1,37 +1,203 @@
 #ifndef CC_UTIL_INTCODE_H_
 #define CC_UTIL_INTCODE_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "absl/base/optimization.h"
+#include "absl/functional/function_ref.h"
+#include "absl/numeric/int128.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "cc/util/check.h"
+#include "cc/util/intcode_jit.h"
+#include "cc/util/intcode_memory.h"
+#include "cc/util/intcode_trace.h"
+#include "cc/util/ring_buffer.h"
+
 namespace aoc2019 {
 
-std::vector<std::int64_t> ReadIntcodeProgram(const char* filename);
+// Reads a comma-separated program, or an image written by WriteIntcodeImage().
+// Dies if a word doesn't fit in 'Word'.
+template <typename Word = std::int64_t>
+std::vector<Word> ReadIntcodeProgram(const char* filename);
 
-class IntcodeMachine {
+// An Intcode machine whose memory cells, inputs and outputs are 'Word's:
+// std::int32_t, std::int64_t or absl::int128. Narrow words halve the memory
+// traffic of programs known to stay small, and wide ones give headroom to
+// programs that would overflow 64 bits. Arithmetic is plain 'Word'
+// arithmetic, so a program whose values overflow 'Word' has undefined
+// behavior: only use a narrow word for a program whose values are known to
+// fit. Only 64-bit machines can compile native code (see EnableJit()); the
+// others always interpret. IntcodeMachine is the 64-bit machine, which every
+// puzzle uses.
+template <typename Word>
+class BasicIntcodeMachine {
  public:
   enum class ExecState {
     kPendingInput,
-    kHalt
+    kHalt,
+    // Only returned by RunFor(), Step(), RunUntilOutput() and RunUntil().
+    kBudgetExhausted,
+    // Only returned by RunUntilOutput() and RunUntil().
+    kOutput,
+    // Only returned by RunUntil(), on reaching StopCondition::pc.
+    kStopped
   };
 
   struct RunResult {
     ExecState state;
-    std::deque<std::int64_t> outputs;
+    std::deque<Word> outputs;
   };
 
-  explicit IntcodeMachine(std::vector<std::int64_t> program)
-      : program_memory_(std::move(program)) {}
+  // If ProveMemoryBound() succeeds for 'program', reserves memory for every
+  // address it can touch and skips range checks on operand loads.
+  explicit BasicIntcodeMachine(absl::Span<const Word> program);
+
+  // Copies share memory pages (see IntcodeMemory) and decoded instructions
+  // with the original until either modifies them.
+  BasicIntcodeMachine(const BasicIntcodeMachine& other) = default;
+  BasicIntcodeMachine& operator=(const BasicIntcodeMachine& other) = default;
+  BasicIntcodeMachine(BasicIntcodeMachine&& other) = default;
+  BasicIntcodeMachine& operator=(BasicIntcodeMachine&& other) = default;
 
+  using OutputFn = absl::FunctionRef<void(Word)>;
+
+  // Runs until the program halts or needs input that hasn't been pushed yet.
   RunResult Run();
 
+  // Like Run(), but appends outputs to 'outputs' rather than returning a new
+  // queue. Reusing the same vector across calls avoids allocating once it has
+  // grown large enough.
+  ExecState Run(std::vector<Word>* outputs);
+
+  // Like Run(), but passes each output to 'on_output' as soon as it is
+  // produced.
+  ExecState Run(OutputFn on_output);
+
+  // Like Run(), but executes at most 'max_instructions' instructions,
+  // returning kBudgetExhausted if the program could have continued. A
+  // subsequent call resumes where this one stopped, so a scheduler can
+  // interleave any number of machines without letting one hog the CPU.
+  ExecState RunFor(std::uint64_t max_instructions, OutputFn on_output);
+  ExecState RunFor(std::uint64_t max_instructions,
+                   std::vector<Word>* outputs);
+
+  // Executes a single instruction, returning kBudgetExhausted if it did so.
+  ExecState Step(OutputFn on_output) { return RunFor(1, on_output); }
+
+  // Runs until the program produces an output, stores it in '*output' and
+  // returns kOutput. Also stops if the program halts, needs input or (for the
+  // second overload) executes 'max_instructions' instructions first.
+  ExecState RunUntilOutput(Word* output);
+  ExecState RunUntilOutput(Word* output,
+                           std::uint64_t max_instructions);
+
+  // When RunUntil() should return, besides when the program halts or needs
+  // input. Conditions left unset never stop it.
+  struct StopCondition {
+    // Stop, returning kOutput, once the program has produced this many
+    // outputs (at least 1) during the call.
+    std::optional<std::uint64_t> num_outputs;
+    // Stop, returning kOutput, after an output for which this returns true.
+    std::function<bool(Word)> output_matches;
+    // Stop, returning kStopped, before executing the instruction at this
+    // address, unless it is the first one the call executes (so that calling
+    // again resumes). Fused instructions and compiled code could skip over
+    // it, so this executes instructions one at a time, several times more
+    // slowly than the other conditions.
+    std::optional<std::uint64_t> pc;
+    // Stop, returning kBudgetExhausted, after executing this many
+    // instructions.
+    std::optional<std::uint64_t> max_instructions;
+  };
+
+  // Like Run(), but also stops as soon as any condition in 'stop' holds, so
+  // that a driver can act on each complete message or event as the program
+  // produces it rather than after it blocks.
+  ExecState RunUntil(const StopCondition& stop, OutputFn on_output);
+  ExecState RunUntil(const StopCondition& stop, std::vector<Word>* outputs);
+
   void RunWithConsoleIO();
 
   void RunWithAsciiConsoleIO();
 
-  void PushInputs(const std::deque<std::int64_t>& inputs);
+  // Queues 'inputs' to be read by the program after any already queued.
+  void PushInputs(absl::Span<const Word> inputs);
+
+  template <typename It>
+  void PushInputs(It begin, It end) {
+    queued_inputs_.Append(begin, end);
+  }
+
+  // Queues each character of 'text' as an input, for programs that read
+  // ASCII.
+  void PushAsciiInputs(absl::string_view text);
+
+  // Sets a function to call for input whenever the queue is empty. If it
+  // returns nullopt, Run() returns kPendingInput as usual.
+  void SetInputSource(std::function<std::optional<Word>()> source);
+
+  // Returns the word at 'address', e.g. to read results a program leaves in
+  // memory rather than outputting.
+  Word ReadMemory(std::uint64_t address) const {
+    return memory_.Load(address);
+  }
+
+  // Compiles frequently executed code to native code from now on: each jump
+  // target once it has been jumped to 'hot_threshold' times. Returns false,
+  // and keeps interpreting everything, if native code generation isn't
+  // supported on this platform or for this word size.
+  bool EnableJit(
+      std::uint32_t hot_threshold = IntcodeJit::kDefaultHotThreshold);
+
+  // Returns the compiler, or null if the JIT isn't enabled.
+  const IntcodeJit* jit() const {
+    return jit_.has_value() ? &*jit_ : nullptr;
+  }
+
+  // Records the last 'capacity' instructions executed, and every input
+  // consumed, from now on (see IntcodeTrace). Compiled code is bypassed while
+  // tracing, so that every instruction is recorded. Enable tracing before the
+  // first run for an input log that ReplayIntcode() can reproduce. Words are
+  // recorded as 64-bit values, so wider ones are truncated.
+  void EnableTrace(std::size_t capacity);
+
+  // Returns the trace, or null if tracing isn't enabled.
+  const IntcodeTrace* trace() const {
+    return trace_.has_value() ? &*trace_ : nullptr;
+  }
+
+  // Returns a machine that continues independently from this one's current
+  // state, including any queued inputs. Only the page table is copied; memory
+  // pages are shared until written, and the decoded instruction cache until
+  // either machine decodes or overwrites an instruction. So forks of a
+  // machine that has already run the code they go on to run cost memory only
+  // for the pages they write.
+  BasicIntcodeMachine Fork() const { return *this; }
+
+  // Puts this machine in the same state as 'other', as assigning a fork of
+  // it would, but reuses this machine's buffers: memory pages it owns are
+  // overwritten in place (see IntcodeMemory::Reset()), as is an instruction
+  // cache it doesn't share, and the input queue keeps its capacity. Resetting
+  // one machine from a snapshot of a freshly loaded program before every run
+  // of many stops allocating after the first few.
+  void Reset(const BasicIntcodeMachine& other);
+
+  // Returns a frozen copy of this machine's current state, which Fork() can
+  // resume from any number of times. Unlike a paused machine, a snapshot may
+  // be forked from several threads at once.
+  std::shared_ptr<const BasicIntcodeMachine> Snapshot() const {
+    return std::make_shared<const BasicIntcodeMachine>(*this);
+  }
 
  private:
   enum class AddressingMode {
@@ -40,41 +206,405 @@ class IntcodeMachine {
     kRelative = 2
   };
 
-  static AddressingMode GetAddressingMode(std::int64_t mode_field);
+  enum class StepResult {
+    kContinue,
+    // The instruction executed and produced an output.
+    kOutput,
+    kPendingInput,
+    kHalt
+  };
+
+  // The JIT emits 64-bit arithmetic on a 64-bit page table.
+  static constexpr bool kJitSupported = std::is_same_v<Word, std::int64_t>;
+
+  struct DecodedInstruction;
+
+  // Executes the instruction at pc_. Every full opcode (operation plus the
+  // addressing modes of all its parameters) has its own handler, so operand
+  // decoding is resolved at compile time rather than on every instruction.
+  using Handler = StepResult (*)(BasicIntcodeMachine* machine,
+                                 const DecodedInstruction& insn,
+                                 OutputFn outputs);
+  using Method = StepResult (BasicIntcodeMachine::*)(
+      const DecodedInstruction& insn, OutputFn outputs);
+
+  // An instruction whose handler and raw parameter words have already been
+  // read out of memory. Entries in 'decoded_' start out pointing at
+  // DecodeAndExecute(), which fills them in on first visit.
+  struct DecodedInstruction {
+    Handler handler = &BasicIntcodeMachine::DecodeAndExecute;
+    Word params[3] = {0, 0, 0};
+  };
+
+  // The instruction cache, which copies of a machine share until one of them
+  // changes it. Decoding only depends on the code words, and a machine that
+  // overwrites code invalidates its own entries, so a shared entry is right
+  // for every machine that shares it.
+  struct DecodeCache {
+    // Indexed by pc. Grows a page at a time to cover the pcs executed so far,
+    // so that it doesn't hold entries for data.
+    std::vector<DecodedInstruction> decoded;
+    // Nonzero for every address covered by an instruction in 'decoded'.
+    std::vector<std::uint8_t> code_marks;
+  };
+
+  // Instructions at or beyond this address are decoded on every visit rather
+  // than cached, so that a jump to a huge address doesn't allocate a huge
+  // cache.
+  static constexpr std::vector<std::int64_t>::size_type kMaxCachedPc = 1 << 20;
+
+  // Opcodes in [0, kDispatchTableSize) are looked up directly. Larger opcodes
+  // can only be valid if they have extra mode digits that are ignored.
+  static constexpr std::int64_t kDispatchTableSize = 22300;
+
+  // Handlers in the kBounded table load operands without range checks. They
+  // are only used once ProveMemoryBound() has shown that every address the
+  // program can touch is covered by the page table.
+  template <bool kBounded>
+  static const std::vector<Handler>& DispatchTable();
+
+  // Returns the smallest opcode equivalent to 'instruction' (i.e. with mode
+  // digits for nonexistent parameters cleared), or -1 if 'instruction' is not
+  // a valid opcode.
+  static std::int64_t CanonicalOpcode(std::int64_t instruction);
+
+  // Converts 'word' to an address. Words that don't fit in 64 bits (only
+  // possible with absl::int128) become invalid addresses, like negative ones.
+  static std::uint64_t ToAddress(Word word);
+
+  // Fills in 'canonical' (indexed by canonical opcode) with the handlers for
+  // every operation using the addressing modes encoded in base-3 by 'kModes'.
+  template <bool kBounded, int kModes>
+  static void RegisterHandlersForModes(std::vector<Handler>* canonical);
+
+  template <bool kBounded, int... kModes>
+  static void RegisterAllHandlers(std::vector<Handler>* canonical,
+                                  std::integer_sequence<int, kModes...>) {
+    (RegisterHandlersForModes<kBounded, kModes>(canonical), ...);
+  }
+
+  // Handlers that run an instruction together with the one after it (see
+  // Fuse()), indexed by the addressing modes (in base 3) of whichever of the
+  // two has variable modes. Null where no handler exists.
+  struct FusedHandlers {
+    // LessThan (0) or Equals (1), then JumpIfFalse (0) or JumpIfTrue (1)
+    // on its result.
+    Handler compare_and_branch[2][2][27] = {};
+    // Add, then an unconditional JumpIfFalse (0) or JumpIfTrue (1).
+    Handler add_then_jump[2][27] = {};
+    // AdjustRelativeBase by an immediate, then an unconditional JumpIfFalse
+    // (0) or JumpIfTrue (1).
+    Handler adjust_then_jump[2] = {};
+    // AdjustRelativeBase by an immediate, then Add.
+    Handler adjust_then_add[27] = {};
+  };
+
+  template <bool kBounded>
+  static const FusedHandlers& FusedHandlerTable();
+
+  template <bool kBounded, int kModes>
+  static void RegisterFusedHandlersForModes(FusedHandlers* fused);
 
-  void MaybeGrow(std::vector<std::int64_t>::size_type position);
+  template <bool kBounded, int... kModes>
+  static void RegisterAllFusedHandlers(FusedHandlers* fused,
+                                       std::integer_sequence<int, kModes...>) {
+    (RegisterFusedHandlersForModes<kBounded, kModes>(fused), ...);
+  }
 
-  std::int64_t LoadParam(std::int64_t mode, std::int64_t value);
+  // Runs until the program halts or needs input. If 'kBudgeted', also stops
+  // once 'budget_' instructions have been executed. If 'stop_on_output', also
+  // stops after every output.
+  template <bool kBudgeted>
+  ExecState Execute(OutputFn on_output, bool stop_on_output) {
+    return ABSL_PREDICT_FALSE(trace_.has_value())
+               ? Execute<kBudgeted, true>(on_output, stop_on_output)
+               : Execute<kBudgeted, false>(on_output, stop_on_output);
+  }
 
-  void Store(std::int64_t mode, std::int64_t value, std::int64_t position);
+  // Like Execute() above. If 'kTraced', records every instruction in
+  // 'trace_'.
+  template <bool kBudgeted, bool kTraced>
+  ExecState Execute(OutputFn on_output, bool stop_on_output);
 
-  template <typename Op>
-  void Math3();
+  // Records the instruction at pc_, which is about to execute, in 'trace_'.
+  void TraceInstruction();
 
-  void Add();
-  void Mul();
+  template <Method kMethod>
+  static StepResult Invoke(BasicIntcodeMachine* machine,
+                           const DecodedInstruction& insn,
+                           OutputFn outputs) {
+    return (machine->*kMethod)(insn, outputs);
+  }
 
-  // Returns true if input was consumed, false if needs more input.
-  bool Input();
-  void Output(std::deque<std::int64_t>* outputs);
+  // Returns the cache entry for pc_, growing the cache if necessary. If pc_ is
+  // too large to cache, returns an entry that decodes without caching.
+  const DecodedInstruction& FetchUncached();
 
-  template <bool if_true>
-  void ConditionalJump();
+  // Decodes the instruction at 'pc'.
+  DecodedInstruction Decode(std::uint64_t pc) const;
 
-  void JumpIfTrue();
-  void JumpIfFalse();
+  // Stores 'decoded', the instruction at 'pc', in the cache.
+  void CacheInstruction(std::uint64_t pc, const DecodedInstruction& decoded);
 
-  void LessThan();
-  void Equals();
+  // Returns the instruction cache for modification, first copying it if any
+  // other machine shares it. Callers that resize it must then call
+  // UpdateCacheViews().
+  DecodeCache& MutableCache();
 
-  void AdjustRelativeBase();
+  // Points 'decoded_' and 'code_marks_' at the contents of 'cache_'.
+  void UpdateCacheViews();
 
-  std::vector<std::int64_t> program_memory_;
+  // If the cached instruction at 'pc' and the one after it form an idiom
+  // that has a fused handler, installs that handler at 'pc', caching the
+  // second instruction too. Compare-then-branch, loop increments followed by
+  // a jump back, and the relative base adjustments of calls and returns
+  // are common in compiled Intcode, and fusing them halves their dispatches.
+  void Fuse(std::uint64_t pc);
+
+  // Decodes the instruction at pc_, caches it if possible, and executes it.
+  static StepResult DecodeAndExecute(BasicIntcodeMachine* machine,
+                                     const DecodedInstruction& insn,
+                                     OutputFn outputs);
+
+  // Handler installed at the start of a compiled block. 'insn.params' holds
+  // the block index and the id of the IntcodeJit that compiled it.
+  static StepResult EnterJitBlock(BasicIntcodeMachine* machine,
+                                  const DecodedInstruction& insn,
+                                  OutputFn outputs);
+
+  // Called by a fused handler once the first instruction has run, with pc_ at
+  // the second. Returns true, counting the second against the budget, if it
+  // may run too: it has to fit in the budget, and its cache entry must still
+  // hold 'expected'. (A store to either instruction resets the fused handler,
+  // but the second's entry can also become a compiled block's entry point.)
+  bool ContinueFused(Handler expected);
+
+  // Called after a jump to pc_ when the JIT is enabled. Compiles a block
+  // starting at pc_ once it is hot.
+  void NoteJumpTarget();
+
+  // Drops cached instructions that cover 'position', which has just been
+  // overwritten.
+  void InvalidateCode(std::vector<std::int64_t>::size_type position);
+
+  // Returns the address that a parameter 'value' refers to in 'mode', which
+  // must not be kImmediate.
+  template <AddressingMode mode>
+  std::uint64_t ParamAddress(Word value) const;
+
+  template <bool kBounded, AddressingMode mode>
+  Word LoadParam(Word value);
+
+  template <AddressingMode mode>
+  void Store(Word value, Word position);
+
+  template <bool kBounded, typename Op, AddressingMode in0,
+            AddressingMode in1, AddressingMode out>
+  StepResult Math3(const DecodedInstruction& insn);
+
+  template <bool kBounded, AddressingMode in0, AddressingMode in1,
+            AddressingMode out>
+  StepResult Add(const DecodedInstruction& insn,
+                 OutputFn outputs);
+  template <bool kBounded, AddressingMode in0, AddressingMode in1,
+            AddressingMode out>
+  StepResult Mul(const DecodedInstruction& insn,
+                 OutputFn outputs);
+
+  // Returns kPendingInput without consuming the instruction if there is no
+  // queued input and the input source (if any) has none either.
+  template <AddressingMode out>
+  StepResult Input(const DecodedInstruction& insn,
+                   OutputFn outputs);
+  template <bool kBounded, AddressingMode in>
+  StepResult Output(const DecodedInstruction& insn,
+                    OutputFn outputs);
+
+  template <bool kBounded, bool if_true, AddressingMode in0,
+            AddressingMode in1>
+  StepResult ConditionalJump(const DecodedInstruction& insn);
+
+  template <bool kBounded, AddressingMode in0, AddressingMode in1>
+  StepResult JumpIfTrue(const DecodedInstruction& insn,
+                        OutputFn outputs);
+  template <bool kBounded, AddressingMode in0, AddressingMode in1>
+  StepResult JumpIfFalse(const DecodedInstruction& insn,
+                         OutputFn outputs);
+
+  template <bool kBounded, AddressingMode in0, AddressingMode in1,
+            AddressingMode out>
+  StepResult LessThan(const DecodedInstruction& insn,
+                      OutputFn outputs);
+  template <bool kBounded, AddressingMode in0, AddressingMode in1,
+            AddressingMode out>
+  StepResult Equals(const DecodedInstruction& insn,
+                    OutputFn outputs);
+
+  template <bool kBounded, AddressingMode in>
+  StepResult AdjustRelativeBase(const DecodedInstruction& insn,
+                                OutputFn outputs);
+
+  // Returns the handler for a jump with the given addressing modes.
+  template <bool kBounded, bool if_true, AddressingMode in0,
+            AddressingMode in1>
+  static constexpr Handler JumpHandler() {
+    if constexpr (if_true) {
+      return &Invoke<&BasicIntcodeMachine::JumpIfTrue<kBounded, in0, in1>>;
+    } else {
+      return &Invoke<&BasicIntcodeMachine::JumpIfFalse<kBounded, in0, in1>>;
+    }
+  }
+
+  // Fused handlers (see FusedHandlers).
+  template <bool kBounded, typename Compare, bool if_true, AddressingMode in0,
+            AddressingMode in1, AddressingMode out>
+  StepResult CompareAndBranch(const DecodedInstruction& insn,
+                              OutputFn outputs);
+  template <bool kBounded, bool if_true, AddressingMode in0,
+            AddressingMode in1, AddressingMode out>
+  StepResult AddThenJump(const DecodedInstruction& insn, OutputFn outputs);
+  template <bool kBounded, bool if_true>
+  StepResult AdjustRelativeBaseThenJump(const DecodedInstruction& insn,
+                                        OutputFn outputs);
+  template <bool kBounded, AddressingMode in0, AddressingMode in1,
+            AddressingMode out>
+  StepResult AdjustRelativeBaseThenAdd(const DecodedInstruction& insn,
+                                       OutputFn outputs);
+
+  StepResult Halt(const DecodedInstruction& insn,
+                  OutputFn outputs);
+
+  // Reports a malformed instruction at pc_ and dies.
+  StepResult IllegalInstruction(const DecodedInstruction& insn,
+                                OutputFn outputs);
+
+  BasicIntcodeMemory<Word> memory_;
+  // True if the page table covers every address the program can touch.
+  bool bounded_ = false;
+  // Null until the first instruction is cached.
+  std::shared_ptr<DecodeCache> cache_;
+  // The contents of 'cache_', read on every instruction without going
+  // through the shared pointer. Only modified through MutableCache().
+  absl::Span<const DecodedInstruction> decoded_;
+  absl::Span<const std::uint8_t> code_marks_;
   std::vector<std::int64_t>::size_type pc_ = 0;
-  std::deque<std::int64_t> queued_inputs_;
-  std::int64_t relative_base_ = 0;
+  RingBuffer<Word> queued_inputs_;
+  std::function<std::optional<Word>()> input_source_;
+  Word relative_base_ = 0;
+  std::optional<IntcodeJit> jit_;
+  std::optional<IntcodeTrace> trace_;
+  // Instructions left before Execute() returns kBudgetExhausted. Effectively
+  // unlimited for unbudgeted runs, which don't count instructions.
+  std::uint64_t budget_ = 0;
 };
 
+extern template class BasicIntcodeMachine<std::int32_t>;
+extern template class BasicIntcodeMachine<std::int64_t>;
+extern template class BasicIntcodeMachine<absl::int128>;
+
+extern template std::vector<std::int32_t> ReadIntcodeProgram<std::int32_t>(
+    const char* filename);
+extern template std::vector<std::int64_t> ReadIntcodeProgram<std::int64_t>(
+    const char* filename);
+extern template std::vector<absl::int128> ReadIntcodeProgram<absl::int128>(
+    const char* filename);
+
+using IntcodeMachine = BasicIntcodeMachine<std::int64_t>;
+
+// Pulls a machine's outputs one at a time, so that a driver consumes them in
+// straight-line code rather than draining the batches Run() returns:
+//
+//   aoc2019::IntcodeOutputs outputs(&machine);
+//   while (std::optional<std::int64_t> x = outputs.Next()) {
+//     const std::int64_t y = outputs.NextOrDie();
+//     ...
+//   }
+//
+// The machine pauses right after each output, so nothing is buffered. Give
+// the machine an input source (see SetInputSource()) to answer its reads on
+// demand as well; otherwise Next() returns when it runs out of input.
+template <typename Word>
+class IntcodeOutputs {
+ public:
+  using ExecState = typename BasicIntcodeMachine<Word>::ExecState;
+
+  class iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Word;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Word*;
+    using reference = const Word&;
+
+    // The end iterator.
+    iterator() = default;
+
+    const Word& operator*() const { return value_; }
+
+    iterator& operator++() {
+      const std::optional<Word> next = outputs_->Next();
+      if (next.has_value()) {
+        value_ = *next;
+      } else {
+        outputs_ = nullptr;
+      }
+      return *this;
+    }
+
+    bool operator==(const iterator& other) const {
+      return outputs_ == other.outputs_;
+    }
+    bool operator!=(const iterator& other) const { return !(*this == other); }
+
+   private:
+    friend class IntcodeOutputs;
+
+    explicit iterator(IntcodeOutputs* outputs) : outputs_(outputs) {
+      ++*this;
+    }
+
+    IntcodeOutputs* outputs_ = nullptr;
+    Word value_ = 0;
+  };
+
+  explicit IntcodeOutputs(BasicIntcodeMachine<Word>* machine)
+      : machine_(machine) {}
+
+  // Runs the machine until its next output and returns it. Returns nullopt
+  // if it halts or needs input first, and state() says which.
+  std::optional<Word> Next() {
+    Word output;
+    state_ = machine_->RunUntilOutput(&output);
+    if (state_ != ExecState::kOutput) return std::nullopt;
+    return output;
+  }
+
+  // Like Next(), but dies if there is no output, e.g. for the rest of a
+  // message whose first word Next() returned.
+  Word NextOrDie() {
+    const std::optional<Word> output = Next();
+    CHECK(output.has_value());
+    return *output;
+  }
+
+  // Iterates over outputs until Next() returns nullopt.
+  iterator begin() { return iterator(this); }
+  iterator end() { return iterator(); }
+
+  // How the last call to Next() stopped.
+  ExecState state() const { return state_; }
+
+ private:
+  BasicIntcodeMachine<Word>* machine_;
+  ExecState state_ = ExecState::kOutput;
+};
+
+// Runs a fresh copy of 'program' on 'input_log' (see IntcodeTrace), which
+// reproduces the traced run without any interactive I/O.
+IntcodeMachine::RunResult ReplayIntcode(
+    const std::vector<std::int64_t>& program,
+    absl::Span<const std::int64_t> input_log);
+
 }  // namespace aoc2019
 
 #endif  // CC_UTIL_INTCODE_H_
@@ -0,0 +1,44 @@
+#include "cc/util/intcode_batch.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "cc/util/intcode.h"
+#include "cc/util/thread_pool.h"
+
+namespace aoc2019 {
+
+std::vector<BatchResult> RunBatch(
+    const std::vector<std::int64_t>& program,
+    absl::Span<const std::vector<std::int64_t>> inputs) {
+  return RunBatch(&ThreadPool::Default(), program, inputs);
+}
+
+std::vector<BatchResult> RunBatch(
+    ThreadPool* pool, const std::vector<std::int64_t>& program,
+    absl::Span<const std::vector<std::int64_t>> inputs) {
+  const std::shared_ptr<const IntcodeMachine> pristine =
+      IntcodeMachine(program).Snapshot();
+  std::vector<std::optional<IntcodeMachine>> machines(pool->num_threads());
+  std::vector<BatchResult> results(inputs.size());
+  pool->ParallelFor(
+      inputs.size(), [&](const int worker, const std::size_t index) {
+        std::optional<IntcodeMachine>& machine = machines[worker];
+        if (machine.has_value()) {
+          // Reuses the machine's buffers rather than allocating new ones.
+          machine->Reset(*pristine);
+        } else {
+          machine.emplace(*pristine);
+        }
+        machine->PushInputs(inputs[index]);
+        BatchResult& result = results[index];
+        result.state = machine->Run(&result.outputs);
+      });
+  return results;
+}
+
+}  // namespace aoc2019
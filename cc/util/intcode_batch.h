@@ -0,0 +1,36 @@
+#ifndef CC_UTIL_INTCODE_BATCH_H_
+#define CC_UTIL_INTCODE_BATCH_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "cc/util/intcode.h"
+#include "cc/util/thread_pool.h"
+
+namespace aoc2019 {
+
+struct BatchResult {
+  IntcodeMachine::ExecState state;
+  std::vector<std::int64_t> outputs;
+};
+
+// Runs a fresh copy of 'program' for each element of 'inputs', pushing that
+// element's inputs and running until the program halts or needs more input.
+// Returns the results in the same order as 'inputs'.
+//
+// Runs are spread over ThreadPool::Default(). Each worker keeps one machine
+// and resets it from a shared snapshot before every run, so the program is
+// only loaded and analyzed once.
+std::vector<BatchResult> RunBatch(
+    const std::vector<std::int64_t>& program,
+    absl::Span<const std::vector<std::int64_t>> inputs);
+
+// Like RunBatch() above, but uses 'pool' rather than the default pool.
+std::vector<BatchResult> RunBatch(
+    ThreadPool* pool, const std::vector<std::int64_t>& program,
+    absl::Span<const std::vector<std::int64_t>> inputs);
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_INTCODE_BATCH_H_
@@ -0,0 +1,77 @@
+// Checks that RunBatch() returns, in order, the same results as running a
+// fresh IntcodeMachine on each input in turn.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cc/util/check.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_batch.h"
+#include "cc/util/thread_pool.h"
+
+namespace aoc2019 {
+namespace {
+
+// Reads numbers, outputting each doubled, until it reads a zero.
+const std::vector<std::int64_t> kDoubler = {
+    3, 20,           // x = input
+    1005, 20, 6,     // if x != 0 goto 6
+    99,              //
+    102, 2, 20, 20,  // 6: x *= 2
+    4, 20,           // output x
+    1105, 1, 0};
+
+// Checks that 'results', from running 'program' on 'inputs', match runs on
+// separate machines.
+void CheckMatchesSequentialRuns(
+    const std::vector<BatchResult>& results,
+    const std::vector<std::int64_t>& program,
+    const std::vector<std::vector<std::int64_t>>& inputs) {
+  CHECK(results.size() == inputs.size());
+  for (std::size_t i = 0; i < inputs.size(); ++i) {
+    IntcodeMachine machine(program);
+    machine.PushInputs(inputs[i]);
+    std::vector<std::int64_t> outputs;
+    CHECK(results[i].state == machine.Run(&outputs));
+    CHECK(results[i].outputs == outputs);
+  }
+}
+
+void TestMatchesSequentialRuns() {
+  std::vector<std::vector<std::int64_t>> doubler_inputs;
+  for (int i = 0; i < 97; ++i) {
+    std::vector<std::int64_t>& inputs = doubler_inputs.emplace_back();
+    for (int j = 0; j < i % 11; ++j) inputs.push_back(i * 100 + j + 1);
+    // Some runs end waiting for input rather than halting.
+    if (i % 4 != 0) inputs.push_back(0);
+  }
+  const std::vector<std::int64_t> sieve =
+      ReadIntcodeProgram("cc/util/testdata/self_modifying_sieve.txt");
+  std::vector<std::vector<std::int64_t>> sieve_inputs;
+  for (int i = 0; i < 97; ++i) sieve_inputs.push_back({i * 37 % 500});
+
+  for (const int num_threads : {1, 2, 0}) {
+    ThreadPool pool(num_threads);
+    for (const std::size_t count : {0, 1, 5, 97}) {
+      const std::vector<std::vector<std::int64_t>> doubler_batch(
+          doubler_inputs.begin(), doubler_inputs.begin() + count);
+      CheckMatchesSequentialRuns(RunBatch(&pool, kDoubler, doubler_batch),
+                                 kDoubler, doubler_batch);
+      const std::vector<std::vector<std::int64_t>> sieve_batch(
+          sieve_inputs.begin(), sieve_inputs.begin() + count);
+      CheckMatchesSequentialRuns(RunBatch(&pool, sieve, sieve_batch), sieve,
+                                 sieve_batch);
+    }
+  }
+  CheckMatchesSequentialRuns(RunBatch(kDoubler, doubler_inputs), kDoubler,
+                             doubler_inputs);
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  aoc2019::TestMatchesSequentialRuns();
+  return 0;
+}
@@ -0,0 +1,408 @@
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "benchmark/benchmark.h"
+#include "cc/util/check.h"
+#include "cc/util/comma_separated.h"
+#include "cc/util/intcode.h"
+
+namespace {
+
+std::int64_t allocations = 0;
+std::int64_t allocated_bytes = 0;
+
+}  // namespace
+
+// The replacements aren't inlined, so that the compiler doesn't see memory
+// from malloc() passed to operator delete (or from operator new passed to
+// free()) and warn about mismatched allocation functions.
+ABSL_ATTRIBUTE_NOINLINE void* operator new(std::size_t size) {
+  ++allocations;
+  allocated_bytes += size;
+  if (void* ptr = std::malloc(size)) return ptr;
+  throw std::bad_alloc();
+}
+
+ABSL_ATTRIBUTE_NOINLINE void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+ABSL_ATTRIBUTE_NOINLINE void operator delete(void* ptr,
+                                             std::size_t /*size*/) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+
+// Reads a value and outputs it three times, forever.
+std::vector<std::int64_t> EchoProgram() {
+  std::vector<std::int64_t> program = {3, 100, 4, 100, 4, 100, 4, 100,
+                                       1105, 1, 0};
+  program.resize(101, 0);
+  return program;
+}
+
+// Feeds the echo program one input and runs it with 'run' once per
+// iteration, reporting the number of heap allocations per iteration.
+template <typename RunFn>
+void RunEcho(benchmark::State& state, RunFn run) {
+  aoc2019::IntcodeMachine machine(EchoProgram());
+  const std::int64_t input[] = {42};
+  const std::int64_t before = allocations;
+  for (auto _ : state) {
+    machine.PushInputs(input);
+    run(&machine);
+  }
+  state.counters["allocs_per_iteration"] = benchmark::Counter(
+      allocations - before, benchmark::Counter::kAvgIterations);
+}
+
+void BM_RunResult(benchmark::State& state) {
+  RunEcho(state, [](aoc2019::IntcodeMachine* machine) {
+    aoc2019::IntcodeMachine::RunResult result = machine->Run();
+    CHECK(result.outputs.size() == 3);
+  });
+}
+BENCHMARK(BM_RunResult);
+
+void BM_RunVector(benchmark::State& state) {
+  std::vector<std::int64_t> outputs;
+  RunEcho(state, [&outputs](aoc2019::IntcodeMachine* machine) {
+    outputs.clear();
+    machine->Run(&outputs);
+    CHECK(outputs.size() == 3);
+  });
+}
+BENCHMARK(BM_RunVector);
+
+void BM_RunCallback(benchmark::State& state) {
+  std::int64_t sum = 0;
+  RunEcho(state, [&sum](aoc2019::IntcodeMachine* machine) {
+    machine->Run([&sum](const std::int64_t value) { sum += value; });
+  });
+  benchmark::DoNotOptimize(sum);
+}
+BENCHMARK(BM_RunCallback);
+
+void BM_RunOutputs(benchmark::State& state) {
+  std::int64_t sum = 0;
+  RunEcho(state, [&sum](aoc2019::IntcodeMachine* machine) {
+    aoc2019::IntcodeOutputs outputs(machine);
+    for (const std::int64_t value : outputs) sum += value;
+  });
+  benchmark::DoNotOptimize(sum);
+}
+BENCHMARK(BM_RunOutputs);
+
+// Computes fib(n) by naive recursion, keeping its frames on a stack addressed
+// through the relative base, as in puzzle 9.
+const std::vector<std::int64_t>& FibProgram() {
+  static const auto* const program = new std::vector<std::int64_t>{
+      109,  74,   3,   73, 21101, 15,    0,    0,     21001, 73, 0,    1,
+      1105, 1,    18,  204, 2,     99,   21207, 1,    2,     3,  1206, 3,
+      32,   21201, 1,  0,   2,     2105, 1,    0,     21101, 45, 0,    4,
+      21201, 1,   -1,  5,   109,   4,    1105, 1,     18,    109, -4,  21201,
+      6,    0,    3,   21101, 64,  0,    4,    21201, 1,     -2, 5,    109,
+      4,    1105, 1,   18,  109,   -4,   22201, 3,    6,     2,  2105, 1,
+      0,    0,    0};
+  return *program;
+}
+
+// Outputs every prime below its input, then their count. The inner loop
+// marks composites by rewriting the address operand of its own store
+// instruction, which exercises code invalidation.
+const std::vector<std::int64_t>& SieveProgram() {
+  static const auto* const program = new std::vector<std::int64_t>{
+      3,     80,   1101, 2,    0,    81,   7,    81,    80,    83,   1006,
+      83,    77,   101,  10000, 81,  84,   1002, 86,    -1,    85,   1,
+      84,    85,   85,   9,    85,   1001, 84,   0,     86,    1208, 0,
+      0,     83,   1006, 83,   70,   1001, 87,   1,     87,    4,    81,
+      2,     81,   81,   82,   7,    82,   80,   83,    1006,  83,   70,
+      101,   10000, 82,  62,   1101, 1,    0,    0,     1,     82,   81,
+      82,    1105, 1,    48,   1001, 81,   1,    81,    1105,  1,    6,
+      4,     87,   99,   0,    0,    0,    0,    0,     0,     0,    0};
+  return *program;
+}
+
+// Returns the number of instructions 'program' executes on 'inputs' before
+// halting or running out of input.
+std::int64_t CountInstructions(const std::vector<std::int64_t>& program,
+                               const std::vector<std::int64_t>& inputs) {
+  aoc2019::IntcodeMachine machine(program);
+  machine.PushInputs(inputs);
+  std::int64_t count = 0;
+  while (machine.Step([](std::int64_t) {}) ==
+         aoc2019::IntcodeMachine::ExecState::kBudgetExhausted) {
+    ++count;
+  }
+  return count;
+}
+
+// Reports the rate of Intcode instructions executed, given that each
+// iteration executes 'per_iteration' of them, and the heap allocations per
+// iteration since 'allocations' was 'allocations_before'.
+void ReportCounters(benchmark::State& state, std::int64_t per_iteration,
+                    std::int64_t allocations_before) {
+  if (per_iteration > 0) {
+    state.counters["instructions"] = benchmark::Counter(
+        per_iteration * state.iterations(), benchmark::Counter::kIsRate);
+  }
+  state.counters["allocs_per_iteration"] =
+      benchmark::Counter(allocations - allocations_before,
+                         benchmark::Counter::kAvgIterations);
+}
+
+// Runs 'program' from the start on 'inputs' once per iteration, compiling
+// hot code first if state.range(0) is nonzero.
+void RunToCompletion(benchmark::State& state,
+                     const std::vector<std::int64_t>& program,
+                     const std::vector<std::int64_t>& inputs) {
+  const std::int64_t instructions = CountInstructions(program, inputs);
+  const std::shared_ptr<const aoc2019::IntcodeMachine> pristine =
+      aoc2019::IntcodeMachine(program).Snapshot();
+  std::vector<std::int64_t> outputs;
+  const std::int64_t before = allocations;
+  for (auto _ : state) {
+    aoc2019::IntcodeMachine machine = pristine->Fork();
+    if (state.range(0) != 0) machine.EnableJit();
+    machine.PushInputs(inputs);
+    outputs.clear();
+    CHECK(machine.Run(&outputs) == aoc2019::IntcodeMachine::ExecState::kHalt);
+  }
+  ReportCounters(state, instructions, before);
+}
+
+void BM_RecursiveFib(benchmark::State& state) {
+  RunToCompletion(state, FibProgram(), {20});
+}
+BENCHMARK(BM_RecursiveFib)->ArgName("jit")->Arg(0)->Arg(1);
+
+void BM_SelfModifyingSieve(benchmark::State& state) {
+  RunToCompletion(state, SieveProgram(), {100000});
+}
+BENCHMARK(BM_SelfModifyingSieve)->ArgName("jit")->Arg(0)->Arg(1);
+
+// Round-robins inputs through state.range(0) echo machines, as puzzle 23's
+// network does: every iteration gives each machine one packet and collects
+// its replies.
+void BM_RoundRobinNetwork(benchmark::State& state) {
+  std::vector<aoc2019::IntcodeMachine> machines(
+      state.range(0), aoc2019::IntcodeMachine(EchoProgram()));
+  std::vector<std::int64_t> outputs;
+  const std::int64_t input[] = {42};
+  const std::int64_t before = allocations;
+  for (auto _ : state) {
+    for (aoc2019::IntcodeMachine& machine : machines) {
+      machine.PushInputs(input);
+      outputs.clear();
+      machine.Run(&outputs);
+    }
+  }
+  // Each machine runs 5 instructions per packet before waiting for another.
+  ReportCounters(state, 5 * state.range(0), before);
+}
+BENCHMARK(BM_RoundRobinNetwork)->Arg(50);
+
+// Constructs a machine, which loads the program and analyzes its memory
+// bound, as puzzle 19 used to for every probe.
+void BM_ConstructMachine(benchmark::State& state) {
+  std::vector<std::int64_t> program = SieveProgram();
+  program.resize(state.range(0), 0);
+  const std::int64_t before = allocations;
+  for (auto _ : state) {
+    aoc2019::IntcodeMachine machine(program);
+    benchmark::DoNotOptimize(&machine);
+  }
+  ReportCounters(state, 0, before);
+}
+BENCHMARK(BM_ConstructMachine)->Arg(100)->Arg(4000);
+
+// Returns a snapshot of the sieve program, padded to 'size' words and paused
+// waiting for its input.
+std::shared_ptr<const aoc2019::IntcodeMachine> PausedSieve(std::size_t size) {
+  std::vector<std::int64_t> program = SieveProgram();
+  program.resize(size, 0);
+  aoc2019::IntcodeMachine paused(program);
+  CHECK(paused.Run().state ==
+        aoc2019::IntcodeMachine::ExecState::kPendingInput);
+  return paused.Snapshot();
+}
+
+// Forks a paused machine and runs the fork briefly, writing to a few pages,
+// as puzzle 15's search does for every step it explores.
+void BM_ForkAndRun(benchmark::State& state) {
+  const std::shared_ptr<const aoc2019::IntcodeMachine> snapshot =
+      PausedSieve(state.range(0));
+  const std::int64_t input[] = {200};
+  std::vector<std::int64_t> outputs;
+  const std::int64_t before = allocations;
+  for (auto _ : state) {
+    aoc2019::IntcodeMachine fork = snapshot->Fork();
+    fork.PushInputs(input);
+    outputs.clear();
+    fork.Run(&outputs);
+  }
+  ReportCounters(state, 0, before);
+}
+BENCHMARK(BM_ForkAndRun)->Arg(100)->Arg(4000);
+
+// Like BM_ForkAndRun, but resets one machine from the snapshot every time
+// rather than forking a new one, as RunBatch() and IntcodeMachinePool do.
+void BM_ResetAndRun(benchmark::State& state) {
+  const std::shared_ptr<const aoc2019::IntcodeMachine> snapshot =
+      PausedSieve(state.range(0));
+  aoc2019::IntcodeMachine machine = snapshot->Fork();
+  const std::int64_t input[] = {200};
+  std::vector<std::int64_t> outputs;
+  const std::int64_t before = allocations;
+  for (auto _ : state) {
+    machine.Reset(*snapshot);
+    machine.PushInputs(input);
+    outputs.clear();
+    machine.Run(&outputs);
+  }
+  ReportCounters(state, 0, before);
+}
+BENCHMARK(BM_ResetAndRun)->Arg(100)->Arg(4000);
+
+// Reads a value, adds 1 to it 'length' times in straight-line code, outputs
+// the sum and loops back to read the next value.
+std::vector<std::int64_t> StraightLineLoop(std::int64_t length) {
+  const std::int64_t sum = 4 * length + 7;
+  std::vector<std::int64_t> program = {3, sum};
+  for (std::int64_t i = 0; i < length; ++i) {
+    program.insert(program.end(), {1001, sum, 1, sum});
+  }
+  program.insert(program.end(), {4, sum, 1105, 1, 0, 0});
+  return program;
+}
+
+// Builds a fleet of 50 copies of one program, as puzzle 23 does for its NICs,
+// and runs each copy once through a loop of state.range(0) instructions that
+// writes a single word. If state.range(1) is nonzero, the copies are forked
+// from a machine that has already run the loop once, as puzzle 15's search
+// forks machines that have already run.
+//
+// The copies always share the program's memory pages, and forks of a warm
+// machine share its decoded instructions too, so they pay for the page they
+// write and a copy of the page table, not for the loop. Copies of a freshly
+// loaded machine each decode the loop themselves, so their bytes per machine
+// grow with the code they execute.
+void BM_MachineFleet(benchmark::State& state) {
+  constexpr int kFleetSize = 50;
+  aoc2019::IntcodeMachine loaded(StraightLineLoop(state.range(0)));
+  if (state.range(1) != 0) {
+    loaded.PushInputs({0});
+    CHECK(loaded.Run().state ==
+          aoc2019::IntcodeMachine::ExecState::kPendingInput);
+  }
+  const std::int64_t input[] = {200};
+  std::vector<std::int64_t> outputs;
+  const std::int64_t before = allocations;
+  const std::int64_t bytes_before = allocated_bytes;
+  for (auto _ : state) {
+    std::vector<aoc2019::IntcodeMachine> fleet(kFleetSize, loaded);
+    for (aoc2019::IntcodeMachine& machine : fleet) {
+      machine.PushInputs(input);
+      outputs.clear();
+      CHECK(machine.Run(&outputs) ==
+            aoc2019::IntcodeMachine::ExecState::kPendingInput);
+      CHECK(outputs.back() == 200 + state.range(0));
+    }
+  }
+  ReportCounters(state, 0, before);
+  state.counters["bytes_per_machine"] =
+      static_cast<double>(allocated_bytes - bytes_before) /
+      (state.iterations() * kFleetSize);
+}
+BENCHMARK(BM_MachineFleet)
+    ->ArgNames({"length", "warm"})
+    ->Args({25, 0})
+    ->Args({25, 1})
+    ->Args({1000, 0})
+    ->Args({1000, 1})
+    ->Args({16000, 0})
+    ->Args({16000, 1});
+
+// Returns 'num_words' comma-separated words that look like a typical
+// program: mostly opcodes and small addresses, with some large and negative
+// constants, and a trailing newline.
+std::string ProgramText(std::size_t num_words) {
+  std::mt19937_64 rng(2019);
+  std::vector<std::int64_t> words(num_words);
+  for (std::int64_t& word : words) {
+    switch (rng() % 4) {
+      case 0:
+        word = 1000 * (rng() % 3) + 100 * (rng() % 3) + 1 + rng() % 9;
+        break;
+      case 1:
+      case 2:
+        word = rng() % 1000;
+        break;
+      default:
+        word = static_cast<std::int64_t>(rng() % 2000000000) - 1000000000;
+        break;
+    }
+  }
+  return absl::StrCat(absl::StrJoin(words, ","), "\n");
+}
+
+void BM_ParseCommaSeparatedInts(benchmark::State& state) {
+  const std::string text = ProgramText(state.range(0));
+  std::vector<std::int64_t> words;
+  for (auto _ : state) {
+    CHECK(aoc2019::ParseCommaSeparatedInts(text, &words));
+    benchmark::DoNotOptimize(words.data());
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_ParseCommaSeparatedInts)->Arg(1 << 10)->Arg(1 << 20);
+
+// What ReadIntcodeProgram() used to do, for comparison.
+void BM_SplitAndSimpleAtoi(benchmark::State& state) {
+  const std::string text = ProgramText(state.range(0));
+  for (auto _ : state) {
+    std::vector<std::int64_t> words;
+    for (const absl::string_view str : absl::StrSplit(text, ',')) {
+      std::int64_t word;
+      CHECK(absl::SimpleAtoi(str, &word));
+      words.push_back(word);
+    }
+    benchmark::DoNotOptimize(words.data());
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_SplitAndSimpleAtoi)->Arg(1 << 10)->Arg(1 << 20);
+
+void BM_ReadIntcodeProgram(benchmark::State& state) {
+  char filename[] = "/tmp/intcode_benchmark_XXXXXX";
+  const int fd = mkstemp(filename);
+  CHECK(fd >= 0);
+  close(fd);
+  std::ofstream(filename) << ProgramText(state.range(0));
+  const std::int64_t before = allocations;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(aoc2019::ReadIntcodeProgram(filename));
+  }
+  ReportCounters(state, 0, before);
+  std::remove(filename);
+}
+BENCHMARK(BM_ReadIntcodeProgram)->Arg(1 << 10)->Arg(1 << 20);
+
+}  // namespace
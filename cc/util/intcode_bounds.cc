@@ -0,0 +1,134 @@
+#include "cc/util/intcode_bounds.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/types/span.h"
+#include "cc/util/intcode_opcodes.h"
+
+namespace aoc2019 {
+namespace {
+
+// Instructions reached with more distinct relative bases than this are assumed
+// to be in a loop that keeps moving the relative base.
+constexpr int kMaxRelativeBases = 16;
+
+// Relative bases, offsets and addresses must stay below this in magnitude, so
+// that nothing overflows.
+constexpr std::int64_t kMaxOffset = std::int64_t{1} << 40;
+
+enum Mode {
+  kAbsolute = 0,
+  kImmediate = 1,
+  kRelative = 2
+};
+
+bool InRange(std::int64_t value) {
+  return value > -kMaxOffset && value < kMaxOffset;
+}
+
+}  // namespace
+
+std::optional<std::uint64_t> ProveMemoryBound(
+    absl::Span<const std::int64_t> program) {
+  const std::uint64_t size = program.size();
+  std::vector<std::uint8_t> is_code(size, 0);
+  std::vector<std::uint8_t> is_stored(size, 0);
+  std::uint64_t bound = size;
+
+  // Relative bases seen at each pc, and (pc, relative base) pairs left to
+  // explore.
+  absl::flat_hash_map<std::uint64_t, absl::flat_hash_set<std::int64_t>> bases;
+  std::vector<std::pair<std::uint64_t, std::int64_t>> worklist;
+  const auto visit = [&](std::uint64_t pc, std::int64_t relative_base) {
+    absl::flat_hash_set<std::int64_t>& seen = bases[pc];
+    if (!seen.insert(relative_base).second) return true;
+    if (seen.size() > kMaxRelativeBases) return false;
+    worklist.emplace_back(pc, relative_base);
+    return true;
+  };
+  visit(0, 0);
+
+  while (!worklist.empty()) {
+    const auto [pc, relative_base] = worklist.back();
+    worklist.pop_back();
+    if (pc >= size) return std::nullopt;
+    const std::int64_t instruction = program[pc];
+    const std::int64_t op = instruction < 0 ? -1 : instruction % 100;
+    const int num_params = ParamCount(op);
+    const std::uint64_t length = std::max(num_params, 0) + 1;
+    if (pc + length > size) return std::nullopt;
+    std::fill_n(is_code.begin() + pc, length, 1);
+
+    Mode modes[3];
+    std::int64_t params[3];
+    bool valid = num_params >= 0;
+    for (int param = 0; valid && param < num_params; ++param) {
+      const std::int64_t mode = instruction / kModeDivisors[param] % 10;
+      params[param] = program[pc + 1 + param];
+      if (mode > 2 || (param == StoreParam(op) && mode == kImmediate)) {
+        valid = false;
+        break;
+      }
+      modes[param] = static_cast<Mode>(mode);
+      if (modes[param] == kImmediate) continue;
+      if (!InRange(params[param])) return std::nullopt;
+      const std::int64_t address = modes[param] == kRelative
+                                       ? relative_base + params[param]
+                                       : params[param];
+      if (address < 0) return std::nullopt;
+      bound = std::max<std::uint64_t>(bound, address + 1);
+      if (param == StoreParam(op) &&
+          static_cast<std::uint64_t>(address) < size) {
+        is_stored[address] = 1;
+      }
+    }
+    // Invalid instructions kill the machine, so nothing follows them.
+    if (!valid) continue;
+
+    switch (op) {
+      case 5:
+      case 6: {
+        if (modes[1] != kImmediate || params[1] < 0) return std::nullopt;
+        bool may_jump = true;
+        bool may_fall_through = true;
+        if (modes[0] == kImmediate) {
+          may_jump = (params[0] != 0) == (op == 5);
+          may_fall_through = !may_jump;
+        }
+        if (may_jump && !visit(params[1], relative_base)) return std::nullopt;
+        if (may_fall_through && !visit(pc + length, relative_base)) {
+          return std::nullopt;
+        }
+        break;
+      }
+      case 9: {
+        if (modes[0] != kImmediate || !InRange(params[0])) return std::nullopt;
+        const std::int64_t next_base = relative_base + params[0];
+        if (!InRange(next_base) || !visit(pc + length, next_base)) {
+          return std::nullopt;
+        }
+        break;
+      }
+      case 99:
+        break;
+      default:
+        if (!visit(pc + length, relative_base)) return std::nullopt;
+        break;
+    }
+  }
+
+  // The analysis read instructions from the initial program, which is only
+  // valid if the program never overwrites them.
+  for (std::uint64_t address = 0; address < size; ++address) {
+    if (is_code[address] != 0 && is_stored[address] != 0) return std::nullopt;
+  }
+  return bound;
+}
+
+}  // namespace aoc2019
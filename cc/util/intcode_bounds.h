@@ -0,0 +1,27 @@
+#ifndef CC_UTIL_INTCODE_BOUNDS_H_
+#define CC_UTIL_INTCODE_BOUNDS_H_
+
+#include <cstdint>
+#include <optional>
+
+#include "absl/types/span.h"
+
+namespace aoc2019 {
+
+// Tries to prove, without running it, that 'program' never touches memory at
+// or beyond some address, whatever inputs it is given. Returns that bound
+// (which is never less than the program's size), or nullopt if no bound could
+// be proven.
+//
+// The analysis follows every path from pc 0, tracking the possible values of
+// the relative base at each instruction. It gives up on computed jumps,
+// relative base adjustments by anything other than an immediate, relative
+// bases that keep changing around a loop, and stores that could modify code.
+// That rules out most programs that use relative mode for a call stack, but
+// covers straight-line and loop-only code.
+std::optional<std::uint64_t> ProveMemoryBound(
+    absl::Span<const std::int64_t> program);
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_INTCODE_BOUNDS_H_
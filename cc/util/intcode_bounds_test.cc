@@ -0,0 +1,81 @@
+// Checks which programs ProveMemoryBound() can bound, and the bounds it
+// proves.
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "cc/util/check.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_bounds.h"
+
+namespace aoc2019 {
+namespace {
+
+// Returns a program that reads 'num_branches' inputs, and after each one
+// adds the next power of two to the relative base if it's nonzero, so that
+// the final output instruction is reached with 2^num_branches bases.
+std::vector<std::int64_t> BranchingBases(int num_branches) {
+  std::vector<std::int64_t> program;
+  for (int i = 0; i < num_branches; ++i) {
+    const std::int64_t next = program.size() + 7;
+    program.insert(program.end(),
+                   {3, 100, 1006, 100, next, 109, std::int64_t{1} << i});
+  }
+  program.insert(program.end(), {204, 0, 99});
+  return program;
+}
+
+void TestProvesBounds() {
+  CHECK(ProveMemoryBound({99}) == 1);
+  // Straight-line code storing past its end.
+  CHECK(ProveMemoryBound({1101, 1, 2, 10, 4, 10, 99}) == 11);
+  // Stores into data inside the program.
+  CHECK(ProveMemoryBound({1101, 1, 1, 7, 4, 7, 99, 0}) == 8);
+  // A countdown loop.
+  CHECK(ProveMemoryBound({3, 20, 1001, 20, -1, 20, 1005, 20, 2, 99}) == 21);
+  // Relative addressing from immediate adjustments, including a loop that
+  // always comes back to the same base.
+  CHECK(ProveMemoryBound({109, 50, 204, 3, 99}) == 54);
+  CHECK(ProveMemoryBound({109, 5, 21101, 1, 1, 30, 109, -5, 3, 40, 1005, 40,
+                          0, 99}) == 41);
+  // A jump that's always taken skips data that isn't a valid instruction...
+  CHECK(ProveMemoryBound({1105, 1, 4, -7, 99}) == 5);
+  // ...and nothing runs after an invalid instruction.
+  CHECK(ProveMemoryBound({1105, 1, 4, 0, 55, 4, 1000}) == 7);
+  // Up to 16 relative bases at one pc.
+  CHECK(ProveMemoryBound(BranchingBases(4)) == 101);
+}
+
+void TestGivesUp() {
+  // A computed jump.
+  CHECK(!ProveMemoryBound({3, 7, 105, 1, 7, 99, 0, 0}).has_value());
+  // A store into code, whether or not it changes it.
+  CHECK(!ProveMemoryBound({1101, 1, 0, 0, 99}).has_value());
+  CHECK(!ProveMemoryBound(
+             ReadIntcodeProgram("cc/util/testdata/self_modifying_sieve.txt"))
+             .has_value());
+  // A relative base that moves on every pass round a loop.
+  CHECK(!ProveMemoryBound({109, 1, 1105, 1, 0}).has_value());
+  // More than 16 relative bases at one pc.
+  CHECK(!ProveMemoryBound(BranchingBases(5)).has_value());
+  // A relative base adjusted by a value read from memory.
+  CHECK(!ProveMemoryBound({9, 3, 99, 5}).has_value());
+  // Negative addresses, absolute and relative.
+  CHECK(!ProveMemoryBound({4, -1, 99}).has_value());
+  CHECK(!ProveMemoryBound({204, -1, 99}).has_value());
+  // An address too large to reason about.
+  CHECK(!ProveMemoryBound({4, std::int64_t{1} << 41, 99}).has_value());
+  // Running off the end of the program.
+  CHECK(!ProveMemoryBound({1101, 1, 1, 5}).has_value());
+  CHECK(!ProveMemoryBound({1101, 1, 1}).has_value());
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  aoc2019::TestProvesBounds();
+  aoc2019::TestGivesUp();
+  return 0;
+}
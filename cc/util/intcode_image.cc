@@ -0,0 +1,187 @@
+#include "cc/util/intcode_image.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "cc/util/check.h"
+
+namespace aoc2019 {
+namespace {
+
+constexpr char kMagic[4] = {'I', 'C', 'I', 'M'};
+constexpr std::size_t kHeaderSize = 16;
+
+constexpr bool kLittleEndian = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+void AppendLittleEndian(std::uint64_t value, int bytes, std::string* out) {
+  for (int byte = 0; byte < bytes; ++byte) {
+    out->push_back(static_cast<char>(value >> (8 * byte)));
+  }
+}
+
+std::uint64_t LoadLittleEndian(const unsigned char* data, int bytes) {
+  std::uint64_t value = 0;
+  for (int byte = 0; byte < bytes; ++byte) {
+    value |= std::uint64_t{data[byte]} << (8 * byte);
+  }
+  return value;
+}
+
+void DieMalformed(const char* filename, const char* reason) {
+  std::cerr << "Malformed Intcode image " << filename << ": " << reason
+            << "\n";
+  CHECK(false);
+}
+
+}  // namespace
+
+std::string EncodeIntcodeImage(absl::Span<const std::int64_t> program,
+                               IntcodeImageEncoding encoding) {
+  std::string image(kMagic, sizeof(kMagic));
+  AppendLittleEndian(static_cast<std::uint32_t>(encoding), 4, &image);
+  AppendLittleEndian(program.size(), 8, &image);
+  switch (encoding) {
+    case IntcodeImageEncoding::kRaw:
+      image.reserve(kHeaderSize + program.size() * sizeof(std::int64_t));
+      for (const std::int64_t word : program) {
+        AppendLittleEndian(word, 8, &image);
+      }
+      break;
+    case IntcodeImageEncoding::kVarint:
+      for (const std::int64_t word : program) {
+        // Zigzag encoding keeps small negative numbers short.
+        std::uint64_t value = (static_cast<std::uint64_t>(word) << 1) ^
+                              static_cast<std::uint64_t>(word >> 63);
+        for (; value >= 0x80; value >>= 7) {
+          image.push_back(static_cast<char>(value | 0x80));
+        }
+        image.push_back(static_cast<char>(value));
+      }
+      break;
+  }
+  return image;
+}
+
+bool WriteIntcodeImage(const char* filename,
+                       absl::Span<const std::int64_t> program,
+                       IntcodeImageEncoding encoding) {
+  const std::string image = EncodeIntcodeImage(program, encoding);
+  std::ofstream stream(filename, std::ios::binary);
+  stream.write(image.data(), image.size());
+  return static_cast<bool>(stream);
+}
+
+std::optional<IntcodeImage> IntcodeImage::Open(const char* filename) {
+  const int fd = open(filename, O_RDONLY);
+  if (fd < 0) return std::nullopt;
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size < 0 ||
+      static_cast<std::uint64_t>(info.st_size) < sizeof(kMagic)) {
+    close(fd);
+    return std::nullopt;
+  }
+  IntcodeImage image;
+  image.mapping_size_ = info.st_size;
+  image.mapping_ =
+      mmap(nullptr, image.mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image.mapping_ == MAP_FAILED) {
+    image.mapping_ = nullptr;
+    return std::nullopt;
+  }
+  const auto* data = static_cast<const unsigned char*>(image.mapping_);
+  if (std::memcmp(data, kMagic, sizeof(kMagic)) != 0) return std::nullopt;
+  if (image.mapping_size_ < kHeaderSize) {
+    DieMalformed(filename, "truncated header");
+  }
+
+  const std::uint64_t encoding = LoadLittleEndian(data + 4, 4);
+  const std::uint64_t num_words = LoadLittleEndian(data + 8, 8);
+  const unsigned char* next = data + kHeaderSize;
+  const unsigned char* const end = data + image.mapping_size_;
+  const std::uint64_t payload_bytes = image.mapping_size_ - kHeaderSize;
+  switch (static_cast<IntcodeImageEncoding>(encoding)) {
+    case IntcodeImageEncoding::kRaw:
+      if (payload_bytes % sizeof(std::int64_t) != 0 ||
+          payload_bytes / sizeof(std::int64_t) != num_words) {
+        DieMalformed(filename, "size doesn't match word count");
+      }
+      if constexpr (kLittleEndian) {
+        // The mapping is page-aligned, so the words are 8-byte aligned.
+        image.words_ = absl::MakeConstSpan(
+            reinterpret_cast<const std::int64_t*>(next), num_words);
+        return image;
+      }
+      image.decoded_.reserve(num_words);
+      for (; next != end; next += sizeof(std::int64_t)) {
+        image.decoded_.push_back(LoadLittleEndian(next, 8));
+      }
+      break;
+    case IntcodeImageEncoding::kVarint:
+      // Every word takes at least one byte.
+      if (num_words > payload_bytes) {
+        DieMalformed(filename, "fewer bytes than words");
+      }
+      image.decoded_.reserve(num_words);
+      while (image.decoded_.size() < num_words) {
+        std::uint64_t value = 0;
+        for (int shift = 0;; shift += 7) {
+          if (next == end || shift > 63) {
+            DieMalformed(filename, "truncated or overlong varint");
+          }
+          value |= std::uint64_t{*next & 0x7fu} << shift;
+          if ((*next++ & 0x80) == 0) break;
+        }
+        image.decoded_.push_back(static_cast<std::int64_t>(value >> 1) ^
+                                 -static_cast<std::int64_t>(value & 1));
+      }
+      if (next != end) DieMalformed(filename, "trailing bytes");
+      break;
+    default:
+      DieMalformed(filename, "unknown encoding");
+  }
+  // Everything has been copied out of the file.
+  image.Unmap();
+  image.words_ = image.decoded_;
+  return image;
+}
+
+IntcodeImage::IntcodeImage(IntcodeImage&& other) noexcept
+    : mapping_(std::exchange(other.mapping_, nullptr)),
+      mapping_size_(std::exchange(other.mapping_size_, 0)),
+      decoded_(std::move(other.decoded_)),
+      words_(std::exchange(other.words_, {})) {}
+
+IntcodeImage& IntcodeImage::operator=(IntcodeImage&& other) noexcept {
+  if (this != &other) {
+    Unmap();
+    mapping_ = std::exchange(other.mapping_, nullptr);
+    mapping_size_ = std::exchange(other.mapping_size_, 0);
+    decoded_ = std::move(other.decoded_);
+    words_ = std::exchange(other.words_, {});
+  }
+  return *this;
+}
+
+IntcodeImage::~IntcodeImage() { Unmap(); }
+
+void IntcodeImage::Unmap() {
+  if (mapping_ != nullptr) munmap(mapping_, mapping_size_);
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+}
+
+}  // namespace aoc2019
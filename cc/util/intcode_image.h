@@ -0,0 +1,66 @@
+#ifndef CC_UTIL_INTCODE_IMAGE_H_
+#define CC_UTIL_INTCODE_IMAGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+
+namespace aoc2019 {
+
+// A binary Intcode program, which loads without any parsing. An image is a
+// 16-byte header followed by the program's words:
+//
+//   bytes 0-3   "ICIM"
+//   bytes 4-7   encoding, as a little-endian IntcodeImageEncoding
+//   bytes 8-15  number of words, little-endian
+//
+// kRaw stores each word as a little-endian int64, so on little-endian hosts
+// the words are used straight out of the mapped file. kVarint stores each
+// word zigzag-encoded as a LEB128 varint, which is usually about a quarter of
+// the size but has to be decoded.
+enum class IntcodeImageEncoding : std::uint32_t { kRaw = 0, kVarint = 1 };
+
+// Returns 'program' as an image.
+std::string EncodeIntcodeImage(absl::Span<const std::int64_t> program,
+                               IntcodeImageEncoding encoding);
+
+// Writes 'program' to 'filename' as an image. Returns false if the file can't
+// be written.
+bool WriteIntcodeImage(const char* filename,
+                       absl::Span<const std::int64_t> program,
+                       IntcodeImageEncoding encoding);
+
+// An image file mapped into memory.
+class IntcodeImage {
+ public:
+  // Maps 'filename'. Returns nullopt if it can't be opened or doesn't start
+  // with the magic number. Dies if it does but is malformed, e.g. truncated.
+  static std::optional<IntcodeImage> Open(const char* filename);
+
+  IntcodeImage(IntcodeImage&& other) noexcept;
+  IntcodeImage& operator=(IntcodeImage&& other) noexcept;
+
+  ~IntcodeImage();
+
+  // Valid for the lifetime of this image.
+  absl::Span<const std::int64_t> words() const { return words_; }
+
+ private:
+  IntcodeImage() = default;
+
+  void Unmap();
+
+  void* mapping_ = nullptr;
+  std::size_t mapping_size_ = 0;
+  // Holds the words if they couldn't be used in place.
+  std::vector<std::int64_t> decoded_;
+  absl::Span<const std::int64_t> words_;
+};
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_INTCODE_IMAGE_H_
@@ -0,0 +1,34 @@
+// Converts an Intcode program (comma-separated, or an existing image) to a
+// binary image that ReadIntcodeProgram() and IntcodeImage can load without
+// parsing.
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_image.h"
+
+int main(int argc, char** argv) {
+  if (argc < 3 || argc > 4) {
+    std::cerr << "USAGE: intcode_image_converter PROGRAM IMAGE [raw|varint]\n";
+    return 1;
+  }
+  aoc2019::IntcodeImageEncoding encoding = aoc2019::IntcodeImageEncoding::kRaw;
+  if (argc == 4) {
+    if (std::strcmp(argv[3], "varint") == 0) {
+      encoding = aoc2019::IntcodeImageEncoding::kVarint;
+    } else if (std::strcmp(argv[3], "raw") != 0) {
+      std::cerr << "Unknown encoding: " << argv[3] << "\n";
+      return 1;
+    }
+  }
+  const std::vector<std::int64_t> program =
+      aoc2019::ReadIntcodeProgram(argv[1]);
+  if (!aoc2019::WriteIntcodeImage(argv[2], program, encoding)) {
+    std::cerr << "Couldn't write " << argv[2] << "\n";
+    return 1;
+  }
+  return 0;
+}
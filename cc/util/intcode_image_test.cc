@@ -0,0 +1,156 @@
+// Checks that Intcode images round-trip through both encodings, that files
+// that aren't images are left to the text parser, and that malformed images
+// are rejected.
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "cc/util/check.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_image.h"
+
+namespace aoc2019 {
+namespace {
+
+constexpr IntcodeImageEncoding kEncodings[] = {IntcodeImageEncoding::kRaw,
+                                               IntcodeImageEncoding::kVarint};
+
+// Returns a path for a scratch file called 'name'.
+std::string TempPath(const char* name) {
+  const char* dir = std::getenv("TEST_TMPDIR");
+  return absl::StrCat(dir != nullptr ? dir : "/tmp", "/intcode_image_test_",
+                      getpid(), "_", name);
+}
+
+void WriteFile(const std::string& path, const std::string& contents) {
+  std::ofstream stream(path, std::ios::binary);
+  stream.write(contents.data(), contents.size());
+  CHECK(stream);
+}
+
+// Returns whether 'fn' exits with an error or crashes when run in a child
+// process.
+bool Dies(absl::FunctionRef<void()> fn) {
+  std::cout.flush();
+  std::cerr.flush();
+  const pid_t pid = fork();
+  CHECK(pid >= 0);
+  if (pid == 0) {
+    // Keep the expected failure's message out of the test's output.
+    std::freopen("/dev/null", "w", stderr);
+    fn();
+    std::_Exit(0);
+  }
+  int status;
+  CHECK(waitpid(pid, &status, 0) == pid);
+  return !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+void TestRoundTrip() {
+  constexpr std::int64_t kMin = std::numeric_limits<std::int64_t>::min();
+  constexpr std::int64_t kMax = std::numeric_limits<std::int64_t>::max();
+  const std::vector<std::vector<std::int64_t>> programs = {
+      {},
+      {99},
+      // Values around each varint length boundary, after zigzag encoding.
+      {0, -1, 1, -64, 63, -65, 64, 8191, -8192, 8192,
+       std::int64_t{1} << 40, -(std::int64_t{1} << 40), kMin, kMax, kMin + 1,
+       kMax - 1},
+      ReadIntcodeProgram("cc/util/testdata/self_modifying_sieve.txt")};
+  const std::string path = TempPath("round_trip");
+  for (const std::vector<std::int64_t>& program : programs) {
+    for (const IntcodeImageEncoding encoding : kEncodings) {
+      const std::string encoded = EncodeIntcodeImage(program, encoding);
+      CHECK(encoded.substr(0, 4) == "ICIM");
+      if (encoding == IntcodeImageEncoding::kRaw) {
+        CHECK(encoded.size() == 16 + 8 * program.size());
+      }
+      CHECK(WriteIntcodeImage(path.c_str(), program, encoding));
+
+      std::optional<IntcodeImage> image = IntcodeImage::Open(path.c_str());
+      CHECK(image.has_value());
+      CHECK(std::vector<std::int64_t>(image->words().begin(),
+                                      image->words().end()) == program);
+      // Words stay valid when the image moves.
+      IntcodeImage moved = std::move(*image);
+      image.reset();
+      CHECK(std::vector<std::int64_t>(moved.words().begin(),
+                                      moved.words().end()) == program);
+
+      CHECK(ReadIntcodeProgram(path.c_str()) == program);
+    }
+  }
+  std::remove(path.c_str());
+}
+
+void TestNotAnImage() {
+  const std::string path = TempPath("not_an_image");
+  CHECK(!IntcodeImage::Open(path.c_str()).has_value());
+  for (const char* contents : {"", "1", "ICI", "1,2,3\n",
+                               "1,2,3,4,5,6,7,8,9,10\n", "ICIN000000000000"}) {
+    WriteFile(path, contents);
+    CHECK(!IntcodeImage::Open(path.c_str()).has_value());
+  }
+  // Text programs still load.
+  WriteFile(path, "1,2,3,4,5,6,7,8,9,10\n");
+  CHECK(ReadIntcodeProgram(path.c_str()) ==
+        std::vector<std::int64_t>({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}));
+  std::remove(path.c_str());
+}
+
+void TestMalformedImagesDie() {
+  const std::vector<std::int64_t> program = {
+      1, -2, 300000, std::numeric_limits<std::int64_t>::min()};
+  const std::string raw =
+      EncodeIntcodeImage(program, IntcodeImageEncoding::kRaw);
+  const std::string varint =
+      EncodeIntcodeImage(program, IntcodeImageEncoding::kVarint);
+  std::string unknown_encoding = raw;
+  unknown_encoding[4] = 7;
+  std::string too_many_words = varint;
+  too_many_words[8] = 100;
+  // One word, in more bytes than any 64-bit value needs.
+  std::string overlong = EncodeIntcodeImage({0}, IntcodeImageEncoding::kVarint);
+  overlong.back() = '\x80';
+  overlong += std::string(10, '\x80') + '\x01';
+
+  const std::string path = TempPath("malformed");
+  for (const std::string& contents : {raw, varint}) {
+    WriteFile(path, contents);
+    CHECK(!Dies([&path] { IntcodeImage::Open(path.c_str()); }));
+  }
+  for (const std::string& contents :
+       {raw.substr(0, 4), raw.substr(0, 15), varint.substr(0, 12),
+        raw.substr(0, raw.size() - 1), raw.substr(0, raw.size() - 8),
+        raw + "x", varint.substr(0, varint.size() - 1), varint + "x",
+        unknown_encoding, too_many_words, overlong}) {
+    WriteFile(path, contents);
+    CHECK(Dies([&path] { IntcodeImage::Open(path.c_str()); }));
+  }
+  std::remove(path.c_str());
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  aoc2019::TestRoundTrip();
+  aoc2019::TestNotAnImage();
+  aoc2019::TestMalformedImagesDie();
+  return 0;
+}
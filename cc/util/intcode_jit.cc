@@ -0,0 +1,801 @@
+#include "cc/util/intcode_jit.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "cc/util/check.h"
+#include "cc/util/intcode_opcodes.h"
+
+namespace aoc2019 {
+namespace {
+
+// Marks a pc that should never be compiled.
+constexpr std::uint32_t kBlacklisted = std::numeric_limits<std::uint32_t>::max();
+
+// Entry counts are only kept for pcs below this.
+constexpr std::uint64_t kMaxTrackedPc = 1 << 20;
+
+constexpr int kMaxBlockInstructions = 64;
+
+// A block whose first instruction can't run natively this many times in a row
+// is dropped.
+constexpr int kMaxStalls = 16;
+
+// A pc whose blocks have been dropped this many times (usually because the
+// program keeps rewriting them) is no longer compiled.
+constexpr int kMaxDrops = 8;
+
+constexpr std::size_t kChunkSize = 64 << 10;
+constexpr std::size_t kMaxCodeBytes = 16 << 20;
+
+std::uint64_t NextId() {
+  static std::atomic<std::uint64_t> next_id{1};
+  return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+enum class Mode {
+  kAbsolute = 0,
+  kImmediate = 1,
+  kRelative = 2
+};
+
+struct JitInstruction {
+  std::uint64_t pc;
+  std::int64_t op;
+  Mode modes[3];
+  std::int64_t params[3];
+  int length;
+};
+
+// Decodes the instruction at 'pc' into 'insn'. Returns false if it is not
+// something that compiled code can run.
+bool DecodeForJit(const IntcodeMemory& memory, std::uint64_t pc,
+                  JitInstruction* insn) {
+  if (pc >= kMaxTrackedPc) return false;
+  const std::int64_t word = memory.Load(pc);
+  if (word < 0 || word >= 100000) return false;
+  insn->pc = pc;
+  insn->op = word % 100;
+  // Input, output and halting are left to the interpreter.
+  if (insn->op == 3 || insn->op == 4 || insn->op == 99) return false;
+  const int num_params = ParamCount(insn->op);
+  if (num_params < 0) return false;
+  const int store_param = StoreParam(insn->op);
+  for (int param = 0; param < num_params; ++param) {
+    const std::int64_t mode = word / kModeDivisors[param] % 10;
+    if (mode > 2) return false;
+    insn->modes[param] = static_cast<Mode>(mode);
+    insn->params[param] = memory.Load(pc + 1 + param);
+    if (param == store_param && insn->modes[param] == Mode::kImmediate) {
+      return false;
+    }
+    if (insn->modes[param] == Mode::kRelative &&
+        (insn->params[param] < std::numeric_limits<std::int32_t>::min() ||
+         insn->params[param] > std::numeric_limits<std::int32_t>::max())) {
+      return false;
+    }
+  }
+  insn->length = num_params + 1;
+  return true;
+}
+
+#if defined(__x86_64__) && defined(__linux__)
+
+enum Reg {
+  kRax = 0,
+  kRcx = 1,
+  kRdx = 2,
+  kRsi = 6,
+  kRdi = 7,
+  kR8 = 8,
+  kR9 = 9,
+  kR10 = 10,
+  kR11 = 11
+};
+
+// Register assignments for compiled blocks.
+constexpr Reg kContextReg = kRdi;
+constexpr Reg kPageTableReg = kR8;
+constexpr Reg kNumPagesReg = kR9;
+constexpr Reg kRelativeBaseReg = kR10;
+constexpr Reg kCodeMarksReg = kR11;
+constexpr Reg kCodeMarksSizeReg = kRsi;
+
+enum Cond : std::uint8_t {
+  kBelow = 0x2,
+  kAboveEqual = 0x3,
+  kEqual = 0x4,
+  kNotEqual = 0x5,
+  kBelowEqual = 0x6,
+  kLess = 0xC
+};
+
+// Pages of absolute addresses below this are looked up by displacement.
+constexpr std::int64_t kMaxDirectAddress = 1 << 27;
+
+constexpr int kPageEntryBits = 4;
+static_assert(sizeof(IntcodeMemory::PageEntry) == 1 << kPageEntryBits,
+              "Page table entries must be 16 bytes");
+
+constexpr std::int32_t kPageOffsetMask = IntcodeMemory::kPageSize - 1;
+
+// Emits the handful of x86-64 instructions compiled blocks need.
+class Assembler {
+ public:
+  const std::vector<std::uint8_t>& code() const { return code_; }
+  std::size_t size() const { return code_.size(); }
+
+  // dst = [base + index * (1 << scale_bits) + disp]. 'index' may be -1.
+  void Load(Reg dst, Reg base, int index, int scale_bits,
+            std::int32_t disp) {
+    Rex(true, dst, index, base);
+    Byte(0x8B);
+    Memory(dst, base, index, scale_bits, disp);
+  }
+
+  // [base + index * (1 << scale_bits) + disp] = src. 'index' may be -1.
+  void Store(Reg base, int index, int scale_bits, std::int32_t disp,
+             Reg src) {
+    Rex(true, src, index, base);
+    Byte(0x89);
+    Memory(src, base, index, scale_bits, disp);
+  }
+
+  // [base + disp] = imm.
+  void StoreImm(Reg base, std::int32_t disp, std::int32_t imm) {
+    Rex(true, 0, -1, base);
+    Byte(0xC7);
+    Memory(0, base, -1, 0, disp);
+    Int32(imm);
+  }
+
+  // [base + disp] -= imm.
+  void SubMemImm(Reg base, std::int32_t disp, std::int32_t imm) {
+    Rex(true, 0, -1, base);
+    Byte(0x81);
+    Memory(5, base, -1, 0, disp);
+    Int32(imm);
+  }
+
+  void Mov(Reg dst, Reg src) {
+    Rex(true, src, -1, dst);
+    Byte(0x89);
+    RegReg(src, dst);
+  }
+
+  void MovImm(Reg dst, std::int64_t imm) {
+    if (imm >= std::numeric_limits<std::int32_t>::min() &&
+        imm <= std::numeric_limits<std::int32_t>::max()) {
+      Rex(true, 0, -1, dst);
+      Byte(0xC7);
+      RegReg(0, dst);
+      Int32(static_cast<std::int32_t>(imm));
+    } else {
+      Rex(true, 0, -1, dst);
+      Byte(0xB8 + (dst & 7));
+      Int64(imm);
+    }
+  }
+
+  void Add(Reg dst, Reg src) {
+    Rex(true, src, -1, dst);
+    Byte(0x01);
+    RegReg(src, dst);
+  }
+
+  void AddImm(Reg dst, std::int32_t imm) {
+    Rex(true, 0, -1, dst);
+    Byte(0x81);
+    RegReg(0, dst);
+    Int32(imm);
+  }
+
+  void AndImm(Reg dst, std::int32_t imm) {
+    Rex(true, 0, -1, dst);
+    Byte(0x81);
+    RegReg(4, dst);
+    Int32(imm);
+  }
+
+  void ShlImm(Reg dst, std::uint8_t bits) {
+    Rex(true, 0, -1, dst);
+    Byte(0xC1);
+    RegReg(4, dst);
+    Byte(bits);
+  }
+
+  // Logical shift.
+  void ShrImm(Reg dst, std::uint8_t bits) {
+    Rex(true, 0, -1, dst);
+    Byte(0xC1);
+    RegReg(5, dst);
+    Byte(bits);
+  }
+
+  void Imul(Reg dst, Reg src) {
+    Rex(true, dst, -1, src);
+    Byte(0x0F);
+    Byte(0xAF);
+    RegReg(dst, src);
+  }
+
+  // Sets flags for 'a - b'.
+  void Cmp(Reg a, Reg b) {
+    Rex(true, b, -1, a);
+    Byte(0x39);
+    RegReg(b, a);
+  }
+
+  void CmpImm(Reg a, std::int32_t imm) {
+    Rex(true, 0, -1, a);
+    Byte(0x81);
+    RegReg(7, a);
+    Int32(imm);
+  }
+
+  // Sets flags for the byte at [base + index] compared to 0.
+  void CmpByteZero(Reg base, Reg index) {
+    Rex(false, 0, index, base);
+    Byte(0x80);
+    Memory(0x7, base, index, 0, 0);
+    Byte(0);
+  }
+
+  void Test(Reg a, Reg b) {
+    Rex(true, b, -1, a);
+    Byte(0x85);
+    RegReg(b, a);
+  }
+
+  // rax = cond ? 1 : 0.
+  void SetRax(Cond cond) {
+    Byte(0x0F);
+    Byte(0x90 | cond);
+    RegReg(0, kRax);
+    Rex(true, kRax, -1, kRax);
+    Byte(0x0F);
+    Byte(0xB6);
+    RegReg(kRax, kRax);
+  }
+
+  // Emits a conditional jump with a placeholder target and returns its
+  // location for Bind().
+  std::size_t Jcc(Cond cond) {
+    Byte(0x0F);
+    Byte(0x80 | cond);
+    Int32(0);
+    return code_.size() - 4;
+  }
+
+  std::size_t Jmp() {
+    Byte(0xE9);
+    Int32(0);
+    return code_.size() - 4;
+  }
+
+  // Jumps back to the already emitted code at 'target'.
+  void JmpTo(std::size_t target) {
+    Byte(0xE9);
+    Int32(static_cast<std::int32_t>(target - (code_.size() + 4)));
+  }
+
+  void Ret() { Byte(0xC3); }
+
+  // Points the jump at 'site' to the current position.
+  void Bind(std::size_t site) {
+    const std::int32_t rel =
+        static_cast<std::int32_t>(code_.size() - (site + 4));
+    std::memcpy(&code_[site], &rel, sizeof(rel));
+  }
+
+ private:
+  void Byte(std::uint8_t byte) { code_.push_back(byte); }
+
+  void Int32(std::int32_t value) {
+    const std::size_t pos = code_.size();
+    code_.resize(pos + sizeof(value));
+    std::memcpy(&code_[pos], &value, sizeof(value));
+  }
+
+  void Int64(std::int64_t value) {
+    const std::size_t pos = code_.size();
+    code_.resize(pos + sizeof(value));
+    std::memcpy(&code_[pos], &value, sizeof(value));
+  }
+
+  void Rex(bool wide, int reg, int index, int base) {
+    const std::uint8_t rex = 0x40 | (wide ? 0x8 : 0) | ((reg >> 3) & 1) << 2 |
+                             (index >= 0 ? ((index >> 3) & 1) << 1 : 0) |
+                             ((base >> 3) & 1);
+    if (rex != 0x40) Byte(rex);
+  }
+
+  void RegReg(int reg, int rm) {
+    Byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+  }
+
+  void Memory(int reg, int base, int index, int scale_bits,
+              std::int32_t disp) {
+    int mod;
+    if (disp == 0 && (base & 7) != 5) {
+      mod = 0;
+    } else if (disp >= -128 && disp <= 127) {
+      mod = 1;
+    } else {
+      mod = 2;
+    }
+    if (index >= 0 || (base & 7) == 4) {
+      Byte(mod << 6 | (reg & 7) << 3 | 4);
+      Byte(scale_bits << 6 | ((index >= 0 ? index : 4) & 7) << 3 |
+           (base & 7));
+    } else {
+      Byte(mod << 6 | (reg & 7) << 3 | (base & 7));
+    }
+    if (mod == 1) {
+      Byte(static_cast<std::uint8_t>(disp));
+    } else if (mod == 2) {
+      Int32(disp);
+    }
+  }
+
+  std::vector<std::uint8_t> code_;
+};
+
+// Generates the code for one block. Compilation follows the program's control
+// flow from the block's start: unconditional jumps to known targets are
+// followed, taken conditional jumps leave the block (or loop back to its
+// start), and the block ends at the first instruction that can't be compiled.
+class BlockCompiler {
+ public:
+  explicit BlockCompiler(const IntcodeMemory& memory) : memory_(memory) {}
+
+  // Returns the code for the block starting at 'start', appends the address
+  // ranges of the instructions it covers to 'block->spans' and sets
+  // 'block->length'. Returns an empty vector if the instruction at 'start'
+  // can't be compiled.
+  std::vector<std::uint8_t> Compile(std::uint64_t start,
+                                    IntcodeJit::Block* block) {
+    std::vector<std::pair<std::uint64_t, std::uint64_t>>* const spans =
+        &block->spans;
+    asm_.Load(kPageTableReg, kContextReg, -1, 0,
+              offsetof(IntcodeJit::Context, pages));
+    asm_.Load(kNumPagesReg, kContextReg, -1, 0,
+              offsetof(IntcodeJit::Context, num_pages));
+    asm_.Load(kRelativeBaseReg, kContextReg, -1, 0,
+              offsetof(IntcodeJit::Context, relative_base));
+    asm_.Load(kCodeMarksReg, kContextReg, -1, 0,
+              offsetof(IntcodeJit::Context, code_marks));
+    asm_.Load(kCodeMarksSizeReg, kContextReg, -1, 0,
+              offsetof(IntcodeJit::Context, code_marks_size));
+    top_ = asm_.size();
+    start_ = start;
+
+    std::vector<std::uint64_t> visited;
+    std::uint64_t pc = start;
+    for (;;) {
+      if (visited.size() == kMaxBlockInstructions ||
+          std::find(visited.begin(), visited.end(), pc) != visited.end()) {
+        Exit(pc, visited.size());
+        break;
+      }
+      JitInstruction insn;
+      if (!DecodeForJit(memory_, pc, &insn)) {
+        if (visited.empty()) return {};
+        Exit(pc, visited.size());
+        break;
+      }
+      visited.push_back(pc);
+      if (!spans->empty() && spans->back().second == pc) {
+        spans->back().second += insn.length;
+      } else {
+        spans->emplace_back(pc, pc + insn.length);
+      }
+
+      current_pc_ = pc;
+      current_index_ = visited.size() - 1;
+      pc += insn.length;
+      if (insn.op == 5 || insn.op == 6) {
+        const std::optional<std::uint64_t> next = ConditionalJump(insn);
+        if (!next.has_value()) break;
+        pc = *next;
+      } else if (insn.op == 9) {
+        LoadOperand(kRax, insn.modes[0], insn.params[0]);
+        asm_.Add(kRelativeBaseReg, kRax);
+      } else {
+        Math3(insn);
+      }
+    }
+
+    // Bail-out stubs return the pc of the instruction that couldn't run.
+    for (const auto& [site, bail_pc, executed] : bails_) {
+      asm_.Bind(site);
+      asm_.StoreImm(kContextReg, offsetof(IntcodeJit::Context, bailed_out),
+                    1);
+      Exit(bail_pc, executed);
+    }
+
+    // Loops that ran out of budget stop at the start of the block, having
+    // already paid for the pass that just finished.
+    for (const std::size_t site : out_of_budget_) {
+      asm_.Bind(site);
+      Exit(start, 0);
+    }
+
+    for (const std::size_t site : exits_) {
+      asm_.Bind(site);
+    }
+    asm_.Store(kContextReg, -1, 0,
+               offsetof(IntcodeJit::Context, relative_base),
+               kRelativeBaseReg);
+    asm_.Ret();
+    block->length = visited.size();
+    return asm_.code();
+  }
+
+ private:
+  void Bail(Cond cond) {
+    bails_.emplace_back(asm_.Jcc(cond), current_pc_, current_index_);
+  }
+
+  // Records that the current pass through the block executed 'executed'
+  // instructions.
+  void SetPartialPass(int executed) {
+    asm_.StoreImm(kContextReg, offsetof(IntcodeJit::Context, partial_pass),
+                  executed);
+  }
+
+  // Jumps to the common epilogue, returning 'pc' after 'executed'
+  // instructions of the current pass.
+  void Exit(std::uint64_t pc, int executed) {
+    SetPartialPass(executed);
+    asm_.MovImm(kRax, static_cast<std::int64_t>(pc));
+    exits_.push_back(asm_.Jmp());
+  }
+
+  // Jumps back to the start of the block after the current instruction,
+  // unless the budget can't cover another full pass.
+  void LoopToStart() {
+    asm_.SubMemImm(kContextReg, offsetof(IntcodeJit::Context, budget),
+                   current_index_ + 1);
+    out_of_budget_.push_back(asm_.Jcc(kBelow));
+    asm_.JmpTo(top_);
+  }
+
+  // Loads the page table entry field at 'field_offset' for the page holding
+  // absolute address 'address' into 'dst', bailing out if the page is beyond
+  // the end of the table.
+  void LoadDirectPageEntry(Reg dst, std::int64_t address,
+                           std::size_t field_offset) {
+    const std::int64_t page = address >> IntcodeMemory::kPageBits;
+    asm_.CmpImm(kNumPagesReg, static_cast<std::int32_t>(page));
+    Bail(kBelowEqual);
+    asm_.Load(dst, kPageTableReg, -1, 0,
+              static_cast<std::int32_t>((page << kPageEntryBits) +
+                                        field_offset));
+  }
+
+  // Like LoadDirectPageEntry(), but for the address held in 'address', which
+  // is left unchanged.
+  void LoadPageEntry(Reg dst, Reg address, std::size_t field_offset) {
+    asm_.Mov(dst, address);
+    asm_.ShrImm(dst, IntcodeMemory::kPageBits);
+    asm_.Cmp(dst, kNumPagesReg);
+    Bail(kAboveEqual);
+    asm_.ShlImm(dst, kPageEntryBits);
+    asm_.Load(dst, kPageTableReg, dst, 0,
+              static_cast<std::int32_t>(field_offset));
+  }
+
+  // Loads an operand into 'dst', which must not be rcx.
+  void LoadOperand(Reg dst, Mode mode, std::int64_t param) {
+    switch (mode) {
+      case Mode::kImmediate:
+        asm_.MovImm(dst, param);
+        return;
+      case Mode::kAbsolute:
+        if (param >= 0 && param < kMaxDirectAddress) {
+          LoadDirectPageEntry(kRcx, param,
+                              offsetof(IntcodeMemory::PageEntry, read));
+          asm_.Load(dst, kRcx, -1, 0,
+                    static_cast<std::int32_t>((param & kPageOffsetMask) * 8));
+          return;
+        }
+        asm_.MovImm(dst, param);
+        break;
+      case Mode::kRelative:
+        asm_.Mov(dst, kRelativeBaseReg);
+        asm_.AddImm(dst, static_cast<std::int32_t>(param));
+        break;
+    }
+    LoadPageEntry(kRcx, dst, offsetof(IntcodeMemory::PageEntry, read));
+    asm_.AndImm(dst, kPageOffsetMask);
+    asm_.Load(dst, kRcx, dst, 3, 0);
+  }
+
+  // Stores rax, bailing out if the destination holds cached code or is in a
+  // page that isn't writable yet. Clobbers rcx and rdx.
+  void StoreResult(Mode mode, std::int64_t param) {
+    if (mode == Mode::kAbsolute) {
+      asm_.MovImm(kRcx, param);
+    } else {
+      asm_.Mov(kRcx, kRelativeBaseReg);
+      asm_.AddImm(kRcx, static_cast<std::int32_t>(param));
+    }
+    asm_.Cmp(kRcx, kCodeMarksSizeReg);
+    const std::size_t unmarked = asm_.Jcc(kAboveEqual);
+    asm_.CmpByteZero(kCodeMarksReg, kRcx);
+    Bail(kNotEqual);
+    asm_.Bind(unmarked);
+
+    if (mode == Mode::kAbsolute && param >= 0 && param < kMaxDirectAddress) {
+      LoadDirectPageEntry(kRdx, param,
+                          offsetof(IntcodeMemory::PageEntry, write));
+      asm_.Test(kRdx, kRdx);
+      Bail(kEqual);
+      asm_.Store(kRdx, -1, 0,
+                 static_cast<std::int32_t>((param & kPageOffsetMask) * 8),
+                 kRax);
+      return;
+    }
+    LoadPageEntry(kRdx, kRcx, offsetof(IntcodeMemory::PageEntry, write));
+    asm_.Test(kRdx, kRdx);
+    Bail(kEqual);
+    asm_.AndImm(kRcx, kPageOffsetMask);
+    asm_.Store(kRdx, kRcx, 3, 0, kRax);
+  }
+
+  void Math3(const JitInstruction& insn) {
+    LoadOperand(kRax, insn.modes[0], insn.params[0]);
+    LoadOperand(kRdx, insn.modes[1], insn.params[1]);
+    switch (insn.op) {
+      case 1:
+        asm_.Add(kRax, kRdx);
+        break;
+      case 2:
+        asm_.Imul(kRax, kRdx);
+        break;
+      case 7:
+        asm_.Cmp(kRax, kRdx);
+        asm_.SetRax(kLess);
+        break;
+      case 8:
+        asm_.Cmp(kRax, kRdx);
+        asm_.SetRax(kEqual);
+        break;
+    }
+    StoreResult(insn.modes[2], insn.params[2]);
+  }
+
+  // Emits a conditional jump. Returns the pc at which the block continues, or
+  // nullopt if control never falls through.
+  std::optional<std::uint64_t> ConditionalJump(const JitInstruction& insn) {
+    const bool if_true = insn.op == 5;
+    const std::uint64_t fallthrough = insn.pc + insn.length;
+    const bool loops_to_start =
+        insn.modes[1] == Mode::kImmediate &&
+        static_cast<std::uint64_t>(insn.params[1]) == start_;
+    if (insn.modes[0] == Mode::kImmediate) {
+      if ((insn.params[0] != 0) != if_true) return fallthrough;
+      if (loops_to_start) {
+        LoopToStart();
+        return std::nullopt;
+      }
+      if (insn.modes[1] == Mode::kImmediate) {
+        return static_cast<std::uint64_t>(insn.params[1]);
+      }
+      LoadOperand(kRax, insn.modes[1], insn.params[1]);
+      SetPartialPass(current_index_ + 1);
+      exits_.push_back(asm_.Jmp());
+      return std::nullopt;
+    }
+
+    LoadOperand(kRax, insn.modes[0], insn.params[0]);
+    asm_.Test(kRax, kRax);
+    const std::size_t not_taken = asm_.Jcc(if_true ? kEqual : kNotEqual);
+    if (loops_to_start) {
+      LoopToStart();
+    } else {
+      LoadOperand(kRax, insn.modes[1], insn.params[1]);
+      SetPartialPass(current_index_ + 1);
+      exits_.push_back(asm_.Jmp());
+    }
+    asm_.Bind(not_taken);
+    return fallthrough;
+  }
+
+  const IntcodeMemory& memory_;
+  Assembler asm_;
+  std::uint64_t start_ = 0;
+  // Code offset of the first instruction, just after the prologue.
+  std::size_t top_ = 0;
+  std::uint64_t current_pc_ = 0;
+  // Position of the current instruction in the pass through the block.
+  int current_index_ = 0;
+  // Jump sites, with the pc and the number of instructions already executed
+  // in the pass.
+  std::vector<std::tuple<std::size_t, std::uint64_t, int>> bails_;
+  std::vector<std::size_t> exits_;
+  std::vector<std::size_t> out_of_budget_;
+};
+
+#endif  // defined(__x86_64__) && defined(__linux__)
+
+}  // namespace
+
+bool IntcodeJit::IsSupported() {
+#if defined(__x86_64__) && defined(__linux__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+IntcodeJit::IntcodeJit(std::uint32_t hot_threshold)
+    : id_(NextId()), hot_threshold_(hot_threshold) {
+  CHECK(hot_threshold >= 1);
+}
+
+IntcodeJit::IntcodeJit(const IntcodeJit& other)
+    : IntcodeJit(other.hot_threshold_) {}
+
+IntcodeJit& IntcodeJit::operator=(const IntcodeJit& other) {
+  if (this != &other) {
+    *this = IntcodeJit(other.hot_threshold_);
+  }
+  return *this;
+}
+
+IntcodeJit::IntcodeJit(IntcodeJit&& other) noexcept
+    : id_(other.id_),
+      hot_threshold_(other.hot_threshold_),
+      num_executed_(other.num_executed_),
+      chunks_(std::move(other.chunks_)),
+      total_code_bytes_(other.total_code_bytes_),
+      blocks_(std::move(other.blocks_)),
+      live_blocks_by_start_(std::move(other.live_blocks_by_start_)),
+      drops_by_start_(std::move(other.drops_by_start_)),
+      entry_counts_(std::move(other.entry_counts_)),
+      live_min_(other.live_min_),
+      live_max_(other.live_max_) {
+  other.chunks_.clear();
+  other.blocks_.clear();
+  other.live_blocks_by_start_.clear();
+  other.total_code_bytes_ = 0;
+  other.live_min_ = other.live_max_ = 0;
+}
+
+IntcodeJit& IntcodeJit::operator=(IntcodeJit&& other) noexcept {
+  if (this != &other) {
+    ReleaseChunks();
+    id_ = other.id_;
+    hot_threshold_ = other.hot_threshold_;
+    num_executed_ = other.num_executed_;
+    chunks_ = std::move(other.chunks_);
+    total_code_bytes_ = other.total_code_bytes_;
+    blocks_ = std::move(other.blocks_);
+    live_blocks_by_start_ = std::move(other.live_blocks_by_start_);
+    drops_by_start_ = std::move(other.drops_by_start_);
+    entry_counts_ = std::move(other.entry_counts_);
+    live_min_ = other.live_min_;
+    live_max_ = other.live_max_;
+    other.chunks_.clear();
+    other.blocks_.clear();
+    other.live_blocks_by_start_.clear();
+    other.total_code_bytes_ = 0;
+    other.live_min_ = other.live_max_ = 0;
+  }
+  return *this;
+}
+
+IntcodeJit::~IntcodeJit() { ReleaseChunks(); }
+
+void IntcodeJit::ReleaseChunks() {
+  for (const CodeChunk& chunk : chunks_) {
+    munmap(chunk.base, chunk.size);
+  }
+  chunks_.clear();
+}
+
+bool IntcodeJit::NoteEntry(std::uint64_t pc) {
+  if (pc >= kMaxTrackedPc) return false;
+  if (pc >= entry_counts_.size()) entry_counts_.resize(pc + 1, 0);
+  std::uint32_t& count = entry_counts_[pc];
+  if (count == kBlacklisted) return false;
+  return ++count == hot_threshold_;
+}
+
+int IntcodeJit::Compile(const IntcodeMemory& memory, std::uint64_t start) {
+  const auto existing = live_blocks_by_start_.find(start);
+  if (existing != live_blocks_by_start_.end()) return existing->second;
+
+#if defined(__x86_64__) && defined(__linux__)
+  Block block;
+  const std::vector<std::uint8_t> code =
+      BlockCompiler(memory).Compile(start, &block);
+  if (code.empty()) {
+    if (start < entry_counts_.size()) entry_counts_[start] = kBlacklisted;
+    return -1;
+  }
+  void* const fn = Install(code);
+  if (fn == nullptr) return -1;
+
+  block.start = start;
+  block.fn = reinterpret_cast<BlockFn>(fn);
+  block.live = true;
+  for (const auto& [begin, end] : block.spans) {
+    if (live_min_ == live_max_) {
+      live_min_ = begin;
+      live_max_ = end;
+    } else {
+      live_min_ = std::min(live_min_, begin);
+      live_max_ = std::max(live_max_, end);
+    }
+  }
+  blocks_.push_back(std::move(block));
+  live_blocks_by_start_[start] = blocks_.size() - 1;
+  return blocks_.size() - 1;
+#else
+  return -1;
+#endif
+}
+
+bool IntcodeJit::NoteStall(int index) {
+  if (++blocks_[index].stalls < kMaxStalls) return false;
+  const std::uint64_t start = blocks_[index].start;
+  Drop(index);
+  if (start < entry_counts_.size()) entry_counts_[start] = kBlacklisted;
+  return true;
+}
+
+void IntcodeJit::Drop(int index) {
+  Block& block = blocks_[index];
+  block.live = false;
+  live_blocks_by_start_.erase(block.start);
+  if (live_blocks_by_start_.empty()) {
+    live_min_ = live_max_ = 0;
+  }
+  if (block.start < entry_counts_.size()) {
+    entry_counts_[block.start] =
+        ++drops_by_start_[block.start] >= kMaxDrops ? kBlacklisted : 0;
+  }
+}
+
+void* IntcodeJit::Install(const std::vector<std::uint8_t>& code) {
+  if (total_code_bytes_ + code.size() > kMaxCodeBytes) return nullptr;
+  if (chunks_.empty() ||
+      chunks_.back().size - chunks_.back().used < code.size()) {
+    const std::size_t page_size = sysconf(_SC_PAGESIZE);
+    const std::size_t size = std::max(
+        kChunkSize, (code.size() + page_size - 1) / page_size * page_size);
+    void* const base = mmap(nullptr, size, PROT_READ | PROT_EXEC,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return nullptr;
+    CodeChunk chunk;
+    chunk.base = static_cast<std::uint8_t*>(base);
+    chunk.size = size;
+    chunks_.push_back(chunk);
+  }
+
+  CodeChunk& chunk = chunks_.back();
+  CHECK(mprotect(chunk.base, chunk.size, PROT_READ | PROT_WRITE) == 0);
+  std::uint8_t* const dest = chunk.base + chunk.used;
+  std::memcpy(dest, code.data(), code.size());
+  CHECK(mprotect(chunk.base, chunk.size, PROT_READ | PROT_EXEC) == 0);
+  // Keep blocks 16-byte aligned.
+  chunk.used = std::min(chunk.size, (chunk.used + code.size() + 15) & ~15);
+  total_code_bytes_ += code.size();
+  return dest;
+}
+
+}  // namespace aoc2019
@@ -0,0 +1,165 @@
+#ifndef CC_UTIL_INTCODE_JIT_H_
+#define CC_UTIL_INTCODE_JIT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "cc/util/intcode_memory.h"
+
+namespace aoc2019 {
+
+// Compiles hot runs of Intcode arithmetic, comparisons, relative base
+// adjustments and jumps to native x86-64 code. Input, output and halt
+// instructions always end a block and are left to the interpreter, as is any
+// instruction that would need to grow memory, write to a page it doesn't own
+// exclusively, or store to an address holding cached code.
+//
+// An IntcodeJit only manages compiled code; IntcodeMachine decides when to
+// compile and is responsible for calling InvalidateCovering() whenever it
+// writes to code.
+class IntcodeJit {
+ public:
+  // Machine state shared with compiled code, which accesses the fields by
+  // fixed offset.
+  struct Context {
+    const IntcodeMemory::PageEntry* pages;
+    std::uint64_t num_pages;
+    std::int64_t relative_base;
+    const std::uint8_t* code_marks;
+    std::uint64_t code_marks_size;
+    // Set to nonzero by compiled code if it returns early.
+    std::uint64_t bailed_out;
+    // Instructions that may still be executed after one more full pass
+    // through the block. Compiled code subtracts the length of each pass that
+    // loops back to the block's start, and returns instead of looping if that
+    // borrows.
+    std::uint64_t budget;
+    // Set by compiled code to the number of instructions executed in the pass
+    // it returned from.
+    std::uint64_t partial_pass;
+  };
+
+  // Runs a compiled block, updating 'context->relative_base', and returns the
+  // pc of the next instruction to execute. If an instruction can't be run
+  // natively, sets 'context->bailed_out' and returns that instruction's pc
+  // without executing it. The number of instructions executed is the
+  // decrease in 'context->budget' (modulo 2^64) plus
+  // 'context->partial_pass'.
+  using BlockFn = std::uint64_t (*)(Context* context);
+
+  struct Block {
+    std::uint64_t start = 0;
+    // Half-open address ranges of the instructions compiled into the block.
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> spans;
+    BlockFn fn = nullptr;
+    // Most instructions a single pass through the block can execute.
+    std::uint64_t length = 0;
+    bool live = false;
+    // Number of consecutive entries that made no progress.
+    int stalls = 0;
+  };
+
+  // Number of jumps to a pc before it is compiled, by default.
+  static constexpr std::uint32_t kDefaultHotThreshold = 64;
+
+  // Returns true if native code can be generated on this platform.
+  static bool IsSupported();
+
+  // Compiles a pc once it has been jumped to 'hot_threshold' times, which must
+  // be at least 1.
+  explicit IntcodeJit(std::uint32_t hot_threshold = kDefaultHotThreshold);
+
+  // Compiled code embeds the contents of the memory it was compiled from, so
+  // copies start out with an empty code cache (and the same threshold).
+  IntcodeJit(const IntcodeJit& other);
+  IntcodeJit& operator=(const IntcodeJit& other);
+
+  IntcodeJit(IntcodeJit&& other) noexcept;
+  IntcodeJit& operator=(IntcodeJit&& other) noexcept;
+
+  ~IntcodeJit();
+
+  // Uniquely identifies this code cache, so that references to its blocks
+  // held by a copied machine can be recognized as stale.
+  std::uint64_t id() const { return id_; }
+
+  // Records a jump to 'pc'. Returns true exactly when 'pc' becomes hot enough
+  // to be worth compiling.
+  bool NoteEntry(std::uint64_t pc);
+
+  // Compiles the block starting at 'start' (or finds an existing live one).
+  // Returns the block's index, or -1 if no instruction at 'start' can be
+  // compiled.
+  int Compile(const IntcodeMemory& memory, std::uint64_t start);
+
+  const Block& block(int index) const { return blocks_[index]; }
+
+  // Records that entering block 'index' made no progress. Returns true if the
+  // block has stalled so often that it was dropped.
+  bool NoteStall(int index);
+
+  // Records that entering block 'index' executed 'executed' instructions.
+  void NoteProgress(int index, std::uint64_t executed) {
+    blocks_[index].stalls = 0;
+    num_executed_ += executed;
+  }
+
+  // Returns the number of instructions compiled code has executed.
+  std::uint64_t num_executed() const { return num_executed_; }
+
+  // Drops every live block covering 'position', calling 'on_drop' with the
+  // start of each.
+  template <typename Fn>
+  void InvalidateCovering(std::uint64_t position, Fn on_drop) {
+    if (position < live_min_ || position >= live_max_) return;
+    for (std::size_t index = 0; index < blocks_.size(); ++index) {
+      const Block& block = blocks_[index];
+      if (!block.live) continue;
+      for (const auto& [begin, end] : block.spans) {
+        if (begin <= position && position < end) {
+          Drop(index);
+          on_drop(block.start);
+          break;
+        }
+      }
+    }
+  }
+
+ private:
+  struct CodeChunk {
+    std::uint8_t* base = nullptr;
+    std::size_t size = 0;
+    std::size_t used = 0;
+  };
+
+  // Copies 'code' into executable memory and returns its address, or nullptr
+  // if the code cache is full.
+  void* Install(const std::vector<std::uint8_t>& code);
+
+  // Marks block 'index' dead, and stops compiling at its start if it has been
+  // dropped too many times.
+  void Drop(int index);
+
+  void ReleaseChunks();
+
+  std::uint64_t id_;
+  std::uint32_t hot_threshold_;
+  std::uint64_t num_executed_ = 0;
+  std::vector<CodeChunk> chunks_;
+  std::size_t total_code_bytes_ = 0;
+  std::vector<Block> blocks_;
+  absl::flat_hash_map<std::uint64_t, int> live_blocks_by_start_;
+  absl::flat_hash_map<std::uint64_t, int> drops_by_start_;
+  // Entry counts indexed by pc.
+  std::vector<std::uint32_t> entry_counts_;
+  // Every live block lies within [live_min_, live_max_).
+  std::uint64_t live_min_ = 0;
+  std::uint64_t live_max_ = 0;
+};
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_INTCODE_JIT_H_
@@ -0,0 +1,201 @@
+// Checks compiled code against the interpreter: every operation the JIT
+// compiles in every addressing mode, the paths that bail out to the
+// interpreter (stores into code or into pages that aren't writable yet) and
+// budgeted runs that stop partway through a compiled loop.
+
+#include <cstdint>
+#include <vector>
+
+#include "cc/util/check.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_jit.h"
+
+namespace aoc2019 {
+namespace {
+
+// Data used by the loop programs below, in the same page as the code.
+constexpr std::int64_t kA = 1000;
+constexpr std::int64_t kB = 1001;
+constexpr std::int64_t kC = 1002;
+constexpr std::int64_t kSum = 1003;
+constexpr std::int64_t kCount = 1004;
+constexpr std::int64_t kTarget = 1005;
+constexpr std::int64_t kStep = 1006;
+// The relative base while the loop runs.
+constexpr std::int64_t kBase = 1100;
+constexpr std::int64_t kProgramSize = 1200;
+
+constexpr std::int64_t kLoopStart = 4;
+constexpr std::int64_t kPasses = 50;
+
+// Returns the operand that reads or writes 'address' in 'mode', or is 'value'
+// in immediate mode.
+std::int64_t Operand(int mode, std::int64_t address, std::int64_t value = 0) {
+  switch (mode) {
+    case 0:
+      return address;
+    case 1:
+      return value;
+    default:
+      return address - kBase;
+  }
+}
+
+// Returns a program that reads a count, then runs 'body' followed by
+// "sum += c, a += 3, b -= 2" that many times, and outputs the sum, a and b.
+// The loop's back edge jumps to kLoopStart, so with a hot threshold of 1 the
+// loop is compiled the first time round.
+std::vector<std::int64_t> LoopProgram(const std::vector<std::int64_t>& body) {
+  std::vector<std::int64_t> program = {109, kBase, 3, kCount};
+  program.insert(program.end(), body.begin(), body.end());
+  program.insert(program.end(),
+                 {1, kC, kSum, kSum, 1001, kA, 3, kA, 1001, kB, -2, kB, 1001,
+                  kCount, -1, kCount, 1005, kCount, kLoopStart, 4, kSum, 4,
+                  kA, 4, kB, 99});
+  program.resize(kProgramSize, 0);
+  // a and b meet at 6 on the 13th pass, which is also the immediate operand
+  // of the instructions under test.
+  program[kA] = -30;
+  program[kB] = 30;
+  // Where jump bodies jump to: past the instruction after the jump.
+  program[kTarget] = kLoopStart + 7;
+  program[kStep] = 7;
+  return program;
+}
+
+struct Slice {
+  IntcodeMachine::ExecState state;
+  std::vector<std::int64_t> outputs;
+
+  bool operator==(const Slice& other) const {
+    return state == other.state && outputs == other.outputs;
+  }
+};
+
+// Runs 'machine' on kPasses until it halts, at most 'slice' instructions at
+// a time (or all at once if 'slice' is 0), returning what each call did.
+std::vector<Slice> RunInSlices(IntcodeMachine* machine, std::uint64_t slice) {
+  machine->PushInputs({kPasses});
+  std::vector<Slice> slices;
+  do {
+    Slice& next = slices.emplace_back();
+    next.state = slice == 0 ? machine->Run(&next.outputs)
+                            : machine->RunFor(slice, &next.outputs);
+  } while (slices.back().state != IntcodeMachine::ExecState::kHalt);
+  return slices;
+}
+
+// Runs 'program' interpreted and compiled, all at once and in slices of
+// several sizes, and checks that the runs stop at the same points with the
+// same outputs and leave the same memory, including at 'extra_addresses'.
+// Returns the number of instructions compiled code executed.
+std::uint64_t CheckMatchesInterpreter(
+    const std::vector<std::int64_t>& program,
+    const std::vector<std::uint64_t>& extra_addresses = {}) {
+  std::uint64_t num_compiled = 0;
+  for (const std::uint64_t slice : {0, 1, 2, 3, 5, 8, 13, 100}) {
+    IntcodeMachine interpreted(program);
+    IntcodeMachine compiled(program);
+    CHECK(compiled.EnableJit(/*hot_threshold=*/1));
+    CHECK(RunInSlices(&compiled, slice) == RunInSlices(&interpreted, slice));
+    for (std::uint64_t address = 0; address < kProgramSize; ++address) {
+      CHECK(compiled.ReadMemory(address) == interpreted.ReadMemory(address));
+    }
+    for (const std::uint64_t address : extra_addresses) {
+      CHECK(compiled.ReadMemory(address) == interpreted.ReadMemory(address));
+    }
+    num_compiled += compiled.jit()->num_executed();
+  }
+  return num_compiled;
+}
+
+void TestArithmeticAndComparisons() {
+  for (const int op : {1, 2, 7, 8}) {
+    for (int in0 = 0; in0 < 3; ++in0) {
+      for (int in1 = 0; in1 < 3; ++in1) {
+        for (const int out : {0, 2}) {
+          const std::int64_t instruction =
+              op + 100 * in0 + 1000 * in1 + 10000 * out;
+          CHECK(CheckMatchesInterpreter(LoopProgram(
+                    {instruction, Operand(in0, kA, 6), Operand(in1, kB, 6),
+                     Operand(out, kC)})) > 0);
+        }
+      }
+    }
+  }
+}
+
+void TestJumps() {
+  for (const int op : {5, 6}) {
+    for (int condition = 0; condition < 3; ++condition) {
+      for (int target = 0; target < 3; ++target) {
+        // When not jumping, adds 1000 to the sum.
+        const std::int64_t instruction = op + 100 * condition + 1000 * target;
+        CHECK(CheckMatchesInterpreter(LoopProgram(
+                  {instruction, Operand(condition, kA, 1),
+                   Operand(target, kTarget, kLoopStart + 7), 1001, kSum, 1000,
+                   kSum})) > 0);
+      }
+    }
+  }
+}
+
+void TestAdjustRelativeBase() {
+  for (int mode = 0; mode < 3; ++mode) {
+    // Moves the relative base by 7, copies a through it into c and moves it
+    // back.
+    CHECK(CheckMatchesInterpreter(LoopProgram(
+              {9 + 100 * mode, Operand(mode, kStep, 7), 1201, kA - kBase - 7,
+               0, kC, 109, -7})) > 0);
+  }
+}
+
+void TestStoreIntoCode() {
+  // Stores the sum into the immediate operand of the loop's first
+  // instruction, so compiled code must bail out and the block be dropped
+  // every pass until the JIT stops compiling it.
+  CHECK(CheckMatchesInterpreter(LoopProgram(
+            {1101, 5, 0, kC, 1001, kSum, 0, kLoopStart + 2})) > 0);
+}
+
+void TestStoresToNewPages() {
+  std::vector<std::uint64_t> written;
+  for (std::int64_t pass = 0; pass <= kPasses; ++pass) {
+    written.push_back(kBase + 512 * pass);
+    written.push_back(kBase + 512 * pass + 512);
+  }
+  // The first instruction stores to a page that isn't writable yet on every
+  // pass, so the block stalls until it is dropped.
+  CheckMatchesInterpreter(LoopProgram({21101, 1, 2, 0, 109, 512}), written);
+  // Here compiled code gets one instruction in before bailing out.
+  CHECK(CheckMatchesInterpreter(LoopProgram({109, 512, 21101, 1, 2, 0}),
+                                written) > 0);
+}
+
+void TestAddressesOutsideThePageTable() {
+  // An absolute address too large to resolve at compile time, which lives in
+  // a sparse page.
+  constexpr std::int64_t kFar = 200000000;
+  CHECK(CheckMatchesInterpreter(LoopProgram({1001, kA, 1, kC, 1101, 1, 2,
+                                             kFar, 1, kFar, kC, kC}),
+                                {kFar}) > 0);
+  // A relative offset too large for compiled code ends the block.
+  constexpr std::int64_t kHuge = std::int64_t{1} << 33;
+  CHECK(CheckMatchesInterpreter(LoopProgram({1001, kA, 1, kC, 21101, 1, 2,
+                                             kHuge}),
+                                {kBase + kHuge}) > 0);
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  if (!aoc2019::IntcodeJit::IsSupported()) return 0;
+  aoc2019::TestArithmeticAndComparisons();
+  aoc2019::TestJumps();
+  aoc2019::TestAdjustRelativeBase();
+  aoc2019::TestStoreIntoCode();
+  aoc2019::TestStoresToNewPages();
+  aoc2019::TestAddressesOutsideThePageTable();
+  return 0;
+}
@@ -0,0 +1,585 @@
+#include "cc/util/intcode_lockstep.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_batch.h"
+#include "cc/util/intcode_opcodes.h"
+#include "cc/util/thread_pool.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define AOC2019_LOCKSTEP_AVX2 1
+#endif
+
+namespace aoc2019 {
+namespace {
+
+// Machines per group.
+constexpr int kLanes = 8;
+
+// Bit i is set if lane i takes part in an operation.
+using LaneMask = std::uint32_t;
+
+// Machines that need this many words of memory or more are rerun on their
+// own.
+constexpr std::uint64_t kMaxWords = std::uint64_t{1} << 16;
+
+// Addresses at or beyond this (i.e. negative ones) are invalid.
+constexpr std::uint64_t kMaxAddress = std::uint64_t{1} << 63;
+
+enum class Mode : std::uint8_t {
+  kAbsolute = 0,
+  kImmediate = 1,
+  kRelative = 2
+};
+
+// Sets out[lane] to op(a[lane], b[lane]) for every lane in 'mask', leaving
+// the other lanes of 'out' unchanged. 'out' may alias 'a' or 'b'.
+using Kernel = void (*)(const std::int64_t* a, const std::int64_t* b,
+                        std::int64_t* out, LaneMask mask);
+
+template <typename Op>
+void GenericKernel(const std::int64_t* a, const std::int64_t* b,
+                   std::int64_t* out, LaneMask mask) {
+  for (int lane = 0; lane < kLanes; ++lane) {
+    if ((mask >> lane & 1) != 0) out[lane] = Op()(a[lane], b[lane]);
+  }
+}
+
+#ifdef AOC2019_LOCKSTEP_AVX2
+
+// Returns a vector whose 64-bit elements are all ones for the lanes set in
+// the low 4 bits of 'mask', and zero otherwise.
+__attribute__((target("avx2"))) inline __m256i Avx2LaneMask(LaneMask mask) {
+  const __m256i bits = _mm256_setr_epi64x(1, 2, 4, 8);
+  return _mm256_cmpeq_epi64(
+      _mm256_and_si256(_mm256_set1_epi64x(mask), bits), bits);
+}
+
+struct Avx2Add {
+  __attribute__((target("avx2"))) static __m256i Apply(__m256i x,
+                                                       __m256i y) {
+    return _mm256_add_epi64(x, y);
+  }
+};
+
+// AVX2 has no 64-bit multiply, so this builds one from 32-bit ones.
+struct Avx2Mul {
+  __attribute__((target("avx2"))) static __m256i Apply(__m256i x,
+                                                       __m256i y) {
+    const __m256i low = _mm256_mul_epu32(x, y);
+    const __m256i cross =
+        _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), y),
+                         _mm256_mul_epu32(x, _mm256_srli_epi64(y, 32)));
+    return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+  }
+};
+
+struct Avx2LessThan {
+  __attribute__((target("avx2"))) static __m256i Apply(__m256i x,
+                                                       __m256i y) {
+    return _mm256_srli_epi64(_mm256_cmpgt_epi64(y, x), 63);
+  }
+};
+
+struct Avx2Equals {
+  __attribute__((target("avx2"))) static __m256i Apply(__m256i x,
+                                                       __m256i y) {
+    return _mm256_srli_epi64(_mm256_cmpeq_epi64(x, y), 63);
+  }
+};
+
+template <typename Op>
+__attribute__((target("avx2"))) void Avx2Kernel(const std::int64_t* a,
+                                                const std::int64_t* b,
+                                                std::int64_t* out,
+                                                LaneMask mask) {
+  for (int lane = 0; lane < kLanes; lane += 4) {
+    const __m256i x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + lane));
+    const __m256i y =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + lane));
+    _mm256_maskstore_epi64(reinterpret_cast<long long*>(out + lane),
+                           Avx2LaneMask(mask >> lane), Op::Apply(x, y));
+  }
+}
+
+#endif  // AOC2019_LOCKSTEP_AVX2
+
+struct Kernels {
+  Kernel add;
+  Kernel mul;
+  Kernel less_than;
+  Kernel equals;
+};
+
+// Returns the fastest kernels this CPU supports, or the portable ones if the
+// INTCODE_LOCKSTEP_PORTABLE environment variable is set.
+const Kernels& SelectKernels() {
+  static const Kernels kernels = [] {
+#ifdef AOC2019_LOCKSTEP_AVX2
+    if (__builtin_cpu_supports("avx2") &&
+        std::getenv("INTCODE_LOCKSTEP_PORTABLE") == nullptr) {
+      return Kernels{&Avx2Kernel<Avx2Add>, &Avx2Kernel<Avx2Mul>,
+                     &Avx2Kernel<Avx2LessThan>, &Avx2Kernel<Avx2Equals>};
+    }
+#endif
+    return Kernels{&GenericKernel<std::plus<std::int64_t>>,
+                   &GenericKernel<std::multiplies<std::int64_t>>,
+                   &GenericKernel<std::less<std::int64_t>>,
+                   &GenericKernel<std::equal_to<std::int64_t>>};
+  }();
+  return kernels;
+}
+
+struct Instruction {
+  // 0 if not decoded yet, or -1 if the instruction is illegal.
+  std::int64_t op = 0;
+  int length = 1;
+  Mode modes[3] = {Mode::kAbsolute, Mode::kAbsolute, Mode::kAbsolute};
+  std::int64_t params[3] = {0, 0, 0};
+};
+
+// Runs groups of up to kLanes machines in lockstep. A runner is reused for
+// every group a worker runs, so that its buffers and instruction cache carry
+// over.
+class LockstepRunner {
+ public:
+  explicit LockstepRunner(const std::vector<std::int64_t>& program)
+      : program_(program), kernels_(SelectKernels()) {}
+
+  // Runs a machine for each element of 'inputs' (of which there may be at
+  // most kLanes), storing the results in 'results'. Returns the machines
+  // that couldn't be run in lockstep, whose results are left empty.
+  LaneMask Run(absl::Span<const std::vector<std::int64_t>> inputs,
+               absl::Span<BatchResult> results);
+
+ private:
+  enum class Status : std::uint8_t {
+    kRunning,
+    kPendingInput,
+    kHalt,
+    kEjected
+  };
+
+  // Returns the 'kLanes' words at 'address', which must be below 'words_'.
+  std::int64_t* Row(std::uint64_t address) {
+    return &memory_[address * kLanes];
+  }
+
+  std::int64_t Word(std::uint64_t address, int lane) const {
+    return address < words_ ? memory_[address * kLanes + lane] : 0;
+  }
+
+  // Executes the instruction at 'pc' for the lanes in 'mask', all of which
+  // are at 'pc'.
+  void Step(std::uint64_t pc, LaneMask mask);
+
+  // Decodes the instruction at 'pc' as seen by 'lane'.
+  Instruction Decode(std::uint64_t pc, int lane) const;
+
+  // Returns the instruction at 'pc'. Lanes that have overwritten it with
+  // something different from the lowest lane in '*mask' are removed from
+  // '*mask', to be run in a later step.
+  Instruction Fetch(std::uint64_t pc, LaneMask* mask);
+
+  // Returns a row holding parameter 'param' of 'insn' for the lanes in
+  // '*mask', which is either in memory or in 'scratch'. Lanes that read a
+  // negative address are ejected and removed from '*mask'.
+  const std::int64_t* LoadOperand(const Instruction& insn, int param,
+                                  LaneMask* mask, std::int64_t* scratch);
+
+  // Returns the address parameter 'param' of 'insn' stores to for 'lane',
+  // growing memory to cover it, or nullopt after ejecting the lane if the
+  // address is out of range.
+  std::optional<std::uint64_t> StoreAddress(const Instruction& insn,
+                                            int param, int lane);
+
+  // Grows memory to cover 'address'. Returns false if it's out of range.
+  bool Reserve(std::uint64_t address);
+
+  // Records that some lane is about to write to 'address'.
+  void NoteWrite(std::uint64_t address);
+
+  void Eject(LaneMask mask);
+
+  void Advance(LaneMask mask, int length) {
+    for (int lane = 0; lane < kLanes; ++lane) {
+      if ((mask >> lane & 1) != 0) pc_[lane] += length;
+    }
+  }
+
+  const std::vector<std::int64_t>& program_;
+  const Kernels& kernels_;
+
+  // Word 'address' of lane 'lane' is at [address * kLanes + lane].
+  std::vector<std::int64_t> memory_;
+  // Words of memory per lane.
+  std::uint64_t words_ = 0;
+  // Nonzero for addresses any lane has written to in the current group.
+  std::vector<std::uint8_t> written_;
+  // Indexed by pc. Only holds instructions decoded from words that no lane
+  // has written to, which are therefore the same for every lane and every
+  // group.
+  std::vector<Instruction> decoded_;
+
+  absl::Span<const std::vector<std::int64_t>> inputs_;
+  absl::Span<BatchResult> results_;
+  std::uint64_t pc_[kLanes];
+  std::int64_t relative_base_[kLanes];
+  std::size_t next_input_[kLanes];
+  Status status_[kLanes];
+};
+
+LaneMask LockstepRunner::Run(
+    absl::Span<const std::vector<std::int64_t>> inputs,
+    absl::Span<BatchResult> results) {
+  inputs_ = inputs;
+  results_ = results;
+  words_ = program_.size();
+  memory_.assign(words_ * kLanes, 0);
+  for (std::uint64_t address = 0; address < words_; ++address) {
+    std::fill_n(Row(address), kLanes, program_[address]);
+  }
+  written_.assign(words_, 0);
+  for (std::size_t lane = 0; lane < kLanes; ++lane) {
+    pc_[lane] = 0;
+    relative_base_[lane] = 0;
+    next_input_[lane] = 0;
+    status_[lane] = lane < inputs.size() ? Status::kRunning : Status::kHalt;
+  }
+
+  for (;;) {
+    // Lanes at the lowest pc go next, so that lanes that branched ahead wait
+    // for the others to catch up.
+    std::uint64_t pc = 0;
+    LaneMask mask = 0;
+    for (int lane = 0; lane < kLanes; ++lane) {
+      if (status_[lane] != Status::kRunning) continue;
+      if (mask == 0 || pc_[lane] < pc) {
+        pc = pc_[lane];
+        mask = LaneMask{1} << lane;
+      } else if (pc_[lane] == pc) {
+        mask |= LaneMask{1} << lane;
+      }
+    }
+    if (mask == 0) break;
+    Step(pc, mask);
+  }
+
+  LaneMask ejected = 0;
+  for (std::size_t lane = 0; lane < inputs.size(); ++lane) {
+    switch (status_[lane]) {
+      case Status::kPendingInput:
+        results[lane].state = IntcodeMachine::ExecState::kPendingInput;
+        break;
+      case Status::kHalt:
+        results[lane].state = IntcodeMachine::ExecState::kHalt;
+        break;
+      case Status::kEjected:
+        results[lane].outputs.clear();
+        ejected |= LaneMask{1} << lane;
+        break;
+      case Status::kRunning:
+        break;
+    }
+  }
+  return ejected;
+}
+
+void LockstepRunner::Step(std::uint64_t pc, LaneMask mask) {
+  const Instruction insn = Fetch(pc, &mask);
+  alignas(32) std::int64_t scratch[3][kLanes] = {};
+  switch (insn.op) {
+    case 1:
+    case 2:
+    case 7:
+    case 8: {
+      // Memory may grow here, so reserve it before holding any pointers
+      // into it.
+      const bool absolute = insn.modes[2] == Mode::kAbsolute;
+      std::uint64_t addresses[kLanes];
+      if (absolute) {
+        if (!Reserve(insn.params[2])) {
+          Eject(mask);
+          return;
+        }
+      } else {
+        for (int lane = 0; lane < kLanes; ++lane) {
+          if ((mask >> lane & 1) == 0) continue;
+          const std::optional<std::uint64_t> address =
+              StoreAddress(insn, 2, lane);
+          if (address.has_value()) {
+            addresses[lane] = *address;
+          } else {
+            mask &= ~(LaneMask{1} << lane);
+          }
+        }
+      }
+      const std::int64_t* a = LoadOperand(insn, 0, &mask, scratch[0]);
+      const std::int64_t* b = LoadOperand(insn, 1, &mask, scratch[1]);
+      if (mask == 0) return;
+      Kernel kernel;
+      switch (insn.op) {
+        case 1:
+          kernel = kernels_.add;
+          break;
+        case 2:
+          kernel = kernels_.mul;
+          break;
+        case 7:
+          kernel = kernels_.less_than;
+          break;
+        default:
+          kernel = kernels_.equals;
+          break;
+      }
+      if (absolute) {
+        NoteWrite(insn.params[2]);
+        kernel(a, b, Row(insn.params[2]), mask);
+      } else {
+        kernel(a, b, scratch[2], mask);
+        for (int lane = 0; lane < kLanes; ++lane) {
+          if ((mask >> lane & 1) == 0) continue;
+          NoteWrite(addresses[lane]);
+          memory_[addresses[lane] * kLanes + lane] = scratch[2][lane];
+        }
+      }
+      Advance(mask, 4);
+      return;
+    }
+    case 3:
+      for (int lane = 0; lane < kLanes; ++lane) {
+        if ((mask >> lane & 1) == 0) continue;
+        const std::vector<std::int64_t>& inputs = inputs_[lane];
+        if (next_input_[lane] == inputs.size()) {
+          status_[lane] = Status::kPendingInput;
+          continue;
+        }
+        const std::optional<std::uint64_t> address =
+            StoreAddress(insn, 0, lane);
+        if (!address.has_value()) continue;
+        NoteWrite(*address);
+        memory_[*address * kLanes + lane] = inputs[next_input_[lane]++];
+        pc_[lane] += 2;
+      }
+      return;
+    case 4: {
+      const std::int64_t* values = LoadOperand(insn, 0, &mask, scratch[0]);
+      for (int lane = 0; lane < kLanes; ++lane) {
+        if ((mask >> lane & 1) == 0) continue;
+        results_[lane].outputs.push_back(values[lane]);
+      }
+      Advance(mask, 2);
+      return;
+    }
+    case 5:
+    case 6: {
+      const std::int64_t* conditions =
+          LoadOperand(insn, 0, &mask, scratch[0]);
+      const std::int64_t* targets = LoadOperand(insn, 1, &mask, scratch[1]);
+      for (int lane = 0; lane < kLanes; ++lane) {
+        if ((mask >> lane & 1) == 0) continue;
+        if ((conditions[lane] != 0) == (insn.op == 5)) {
+          pc_[lane] = targets[lane];
+        } else {
+          pc_[lane] += 3;
+        }
+      }
+      return;
+    }
+    case 9: {
+      const std::int64_t* offsets = LoadOperand(insn, 0, &mask, scratch[0]);
+      for (int lane = 0; lane < kLanes; ++lane) {
+        if ((mask >> lane & 1) == 0) continue;
+        relative_base_[lane] += offsets[lane];
+      }
+      Advance(mask, 2);
+      return;
+    }
+    case 99:
+      for (int lane = 0; lane < kLanes; ++lane) {
+        if ((mask >> lane & 1) != 0) status_[lane] = Status::kHalt;
+      }
+      return;
+    default:
+      // Let IntcodeMachine report the illegal instruction.
+      Eject(mask);
+      return;
+  }
+}
+
+Instruction LockstepRunner::Decode(std::uint64_t pc, int lane) const {
+  Instruction insn;
+  insn.op = -1;
+  const std::int64_t word = Word(pc, lane);
+  if (word < 0) return insn;
+  const std::int64_t op = word % 100;
+  const int num_params = ParamCount(op);
+  if (num_params < 0) return insn;
+  for (int param = 0; param < num_params; ++param) {
+    const std::int64_t mode = word / kModeDivisors[param] % 10;
+    if (mode > 2 || (param == StoreParam(op) &&
+                     mode == static_cast<std::int64_t>(Mode::kImmediate))) {
+      return insn;
+    }
+    insn.modes[param] = static_cast<Mode>(mode);
+    insn.params[param] = Word(pc + 1 + param, lane);
+  }
+  insn.op = op;
+  insn.length = num_params + 1;
+  return insn;
+}
+
+Instruction LockstepRunner::Fetch(std::uint64_t pc, LaneMask* mask) {
+  if (pc < decoded_.size() && decoded_[pc].op != 0) return decoded_[pc];
+
+  const int lead = __builtin_ctz(*mask);
+  const Instruction insn = Decode(pc, lead);
+  bool clean = true;
+  for (std::uint64_t address = pc; address < pc + insn.length; ++address) {
+    if (address < words_ && written_[address] != 0) {
+      clean = false;
+      break;
+    }
+  }
+  if (clean) {
+    if (pc < kMaxWords) {
+      if (pc >= decoded_.size()) decoded_.resize(pc + 1);
+      decoded_[pc] = insn;
+    }
+    return insn;
+  }
+
+  for (int lane = lead + 1; lane < kLanes; ++lane) {
+    if ((*mask >> lane & 1) == 0) continue;
+    for (std::uint64_t address = pc; address < pc + insn.length; ++address) {
+      if (Word(address, lane) != Word(address, lead)) {
+        *mask &= ~(LaneMask{1} << lane);
+        break;
+      }
+    }
+  }
+  return insn;
+}
+
+const std::int64_t* LockstepRunner::LoadOperand(const Instruction& insn,
+                                                int param, LaneMask* mask,
+                                                std::int64_t* scratch) {
+  const std::int64_t value = insn.params[param];
+  switch (insn.modes[param]) {
+    case Mode::kImmediate:
+      std::fill_n(scratch, kLanes, value);
+      return scratch;
+    case Mode::kAbsolute: {
+      const std::uint64_t address = value;
+      if (address >= kMaxAddress) {
+        Eject(*mask);
+        *mask = 0;
+        return scratch;
+      }
+      if (address < words_) return Row(address);
+      return scratch;
+    }
+    case Mode::kRelative:
+      for (int lane = 0; lane < kLanes; ++lane) {
+        if ((*mask >> lane & 1) == 0) continue;
+        const std::uint64_t address =
+            static_cast<std::uint64_t>(relative_base_[lane]) + value;
+        if (address >= kMaxAddress) {
+          Eject(LaneMask{1} << lane);
+          *mask &= ~(LaneMask{1} << lane);
+          continue;
+        }
+        scratch[lane] = Word(address, lane);
+      }
+      return scratch;
+  }
+  return scratch;
+}
+
+std::optional<std::uint64_t> LockstepRunner::StoreAddress(
+    const Instruction& insn, int param, int lane) {
+  std::uint64_t address = insn.params[param];
+  if (insn.modes[param] == Mode::kRelative) address += relative_base_[lane];
+  if (!Reserve(address)) {
+    Eject(LaneMask{1} << lane);
+    return std::nullopt;
+  }
+  return address;
+}
+
+bool LockstepRunner::Reserve(std::uint64_t address) {
+  if (address < words_) return true;
+  if (address >= kMaxWords) return false;
+  words_ = std::min(std::max(address + 1, 2 * words_), kMaxWords);
+  memory_.resize(words_ * kLanes, 0);
+  written_.resize(words_, 0);
+  return true;
+}
+
+void LockstepRunner::NoteWrite(std::uint64_t address) {
+  if (written_[address] != 0) return;
+  written_[address] = 1;
+  // Instructions are at most 4 words long, so only the ones starting in the 3
+  // words before 'address' (or at it) can cover it.
+  const std::uint64_t first = address < 3 ? 0 : address - 3;
+  for (std::uint64_t pc = first; pc <= address && pc < decoded_.size();
+       ++pc) {
+    decoded_[pc].op = 0;
+  }
+}
+
+void LockstepRunner::Eject(LaneMask mask) {
+  for (int lane = 0; lane < kLanes; ++lane) {
+    if ((mask >> lane & 1) != 0) status_[lane] = Status::kEjected;
+  }
+}
+
+}  // namespace
+
+std::vector<BatchResult> RunLockstep(
+    const std::vector<std::int64_t>& program,
+    absl::Span<const std::vector<std::int64_t>> inputs) {
+  return RunLockstep(&ThreadPool::Default(), program, inputs);
+}
+
+std::vector<BatchResult> RunLockstep(
+    ThreadPool* pool, const std::vector<std::int64_t>& program,
+    absl::Span<const std::vector<std::int64_t>> inputs) {
+  const std::shared_ptr<const IntcodeMachine> pristine =
+      IntcodeMachine(program).Snapshot();
+  std::vector<std::optional<LockstepRunner>> runners(pool->num_threads());
+  std::vector<BatchResult> results(inputs.size());
+  const std::size_t num_groups = (inputs.size() + kLanes - 1) / kLanes;
+  pool->ParallelFor(
+      num_groups, [&](const int worker, const std::size_t group) {
+        std::optional<LockstepRunner>& runner = runners[worker];
+        if (!runner.has_value()) runner.emplace(program);
+        const std::size_t begin = group * kLanes;
+        const std::size_t count =
+            std::min<std::size_t>(kLanes, inputs.size() - begin);
+        const LaneMask ejected =
+            runner->Run(inputs.subspan(begin, count),
+                        absl::MakeSpan(results).subspan(begin, count));
+        for (std::size_t lane = 0; lane < count; ++lane) {
+          if ((ejected >> lane & 1) == 0) continue;
+          IntcodeMachine machine = pristine->Fork();
+          machine.PushInputs(inputs[begin + lane]);
+          BatchResult& result = results[begin + lane];
+          result.state = machine.Run(&result.outputs);
+        }
+      });
+  return results;
+}
+
+}  // namespace aoc2019
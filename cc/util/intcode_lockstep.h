@@ -0,0 +1,39 @@
+#ifndef CC_UTIL_INTCODE_LOCKSTEP_H_
+#define CC_UTIL_INTCODE_LOCKSTEP_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "cc/util/intcode_batch.h"
+#include "cc/util/thread_pool.h"
+
+namespace aoc2019 {
+
+// Computes the same results as RunBatch(), but runs machines in groups that
+// execute in lockstep, with the groups spread over ThreadPool::Default().
+//
+// A group keeps its machines' memories interleaved word by word, so each
+// instruction is decoded once for the whole group, and arithmetic and
+// comparisons run on every machine at once (with AVX2, if the CPU has it and
+// the INTCODE_LOCKSTEP_PORTABLE environment variable isn't set).
+// Each step executes the instruction at the lowest pc any machine in the
+// group has reached, for every machine at that pc; machines that branched
+// elsewhere sit out until the others catch up. A machine that touches a
+// negative or very large address, or hits an illegal instruction, is rerun
+// from the start on an IntcodeMachine.
+//
+// This is fastest for programs like puzzle 19's, which do the same thing for
+// every input with a little data-dependent branching.
+std::vector<BatchResult> RunLockstep(
+    const std::vector<std::int64_t>& program,
+    absl::Span<const std::vector<std::int64_t>> inputs);
+
+// Like RunLockstep() above, but uses 'pool' rather than the default pool.
+std::vector<BatchResult> RunLockstep(
+    ThreadPool* pool, const std::vector<std::int64_t>& program,
+    absl::Span<const std::vector<std::int64_t>> inputs);
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_INTCODE_LOCKSTEP_H_
@@ -0,0 +1,248 @@
+// Checks RunLockstep() against RunBatch() on programs whose machines branch
+// apart, rewrite their code differently, or have to be rerun on their own,
+// over batches that don't fill the last group. Run with
+// INTCODE_LOCKSTEP_PORTABLE set to check the portable kernels too.
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/types/span.h"
+#include "cc/util/check.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_batch.h"
+#include "cc/util/intcode_lockstep.h"
+#include "cc/util/thread_pool.h"
+
+namespace aoc2019 {
+namespace {
+
+// Reads n and k, then sums i * k over i < min(n, k) and i + k over the rest
+// of i < n. Outputs the sum, and 1 if it took the second branch.
+const std::vector<std::int64_t> kBranchy = {
+    109, 200,             // rb = 200
+    203, 0,               // n = input
+    203, 1,               // k = input
+    21101, 0, 0, 2,       // i = 0
+    21101, 0, 0, 3,       // sum = 0
+    22207, 2, 0, 4,       // 14: t = i < n
+    1206, 4, 54,          // if !t goto 54
+    22207, 2, 1, 4,       // t = i < k
+    1206, 4, 35,          // if !t goto 35
+    22202, 2, 1, 5,       // v = i * k
+    1105, 1, 43,          // goto 43
+    22201, 2, 1, 5,       // 35: v = i + k
+    21108, 7, 7, 6,       // took_else = 1
+    22201, 3, 5, 3,       // 43: sum += v
+    21201, 2, 1, 2,       // i += 1
+    1105, 1, 14,          // goto 14
+    204, 3,               // 54: output sum
+    4, 206,               // output took_else
+    99};
+
+// Reads an instruction (add, multiply, less than or equals, with immediate
+// operands) and writes it over the code, then reads operands for it until one
+// is zero, outputting each result.
+const std::vector<std::int64_t> kSelfModifying = {
+    3, 4,           // instruction = input
+    3, 5,           // 2: operand = input
+    0, 0, 3, 20,    // 4: mem[20] = operand <instruction> 3
+    4, 20,          // output mem[20]
+    1005, 5, 2,     // if operand != 0 goto 2
+    99};
+
+// Reads an offset and a value, stores the value at the offset and outputs
+// it. Then reads a flag, and if it's nonzero also stores to and outputs a
+// far absolute address.
+const std::vector<std::int64_t> kFarStores = {
+    3, 30,                   // offset = input
+    9, 30,                   // rb += offset
+    203, 0,                  // mem[rb] = input
+    204, 0,                  // output mem[rb]
+    3, 31,                   // flag = input
+    1006, 31, 19,            // if flag == 0 goto 19
+    1101, 1, 2, 100000,      // mem[100000] = 3
+    4, 100000,               // output mem[100000]
+    99};                     // 19
+
+// Reads pairs of numbers, outputting their sum, product, whether the first is
+// less than the second, and whether they're equal.
+const std::vector<std::int64_t> kArithmetic = {
+    3, 50, 3, 51,          // a, b = input
+    1, 50, 51, 52, 4, 52,  // output a + b
+    2, 50, 51, 52, 4, 52,  // output a * b
+    7, 50, 51, 52, 4, 52,  // output a < b
+    8, 50, 51, 52, 4, 52,  // output a == b
+    1105, 1, 0};
+
+bool SameResults(const std::vector<BatchResult>& a,
+                 const std::vector<BatchResult>& b) {
+  if (a.size() != b.size()) return false;
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    if (a[i].state != b[i].state || a[i].outputs != b[i].outputs) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Checks that RunLockstep() matches RunBatch() on prefixes of 'inputs' of
+// several lengths, with one and several threads.
+void CheckMatchesBatch(const std::vector<std::int64_t>& program,
+                       const std::vector<std::vector<std::int64_t>>& inputs) {
+  for (const int num_threads : {1, 3}) {
+    ThreadPool pool(num_threads);
+    for (const std::size_t count : {std::size_t{0}, std::size_t{1},
+                                    std::size_t{5}, std::size_t{8},
+                                    std::size_t{13}, inputs.size()}) {
+      const absl::Span<const std::vector<std::int64_t>> batch =
+          absl::MakeConstSpan(inputs).first(std::min(count, inputs.size()));
+      CHECK(SameResults(RunLockstep(&pool, program, batch),
+                        RunBatch(&pool, program, batch)));
+    }
+  }
+}
+
+// Returns whether 'fn' exits with an error or crashes when run in a child
+// process.
+bool Dies(absl::FunctionRef<void()> fn) {
+  std::cout.flush();
+  std::cerr.flush();
+  const pid_t pid = fork();
+  CHECK(pid >= 0);
+  if (pid == 0) {
+    // Keep the expected failure's message out of the test's output.
+    std::freopen("/dev/null", "w", stderr);
+    fn();
+    std::_Exit(0);
+  }
+  int status;
+  CHECK(waitpid(pid, &status, 0) == pid);
+  return !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+// Checks that RunLockstep() and RunBatch() both fail on 'inputs', which make
+// some machine do something IntcodeMachine rejects.
+void CheckBothDie(const std::vector<std::int64_t>& program,
+                  const std::vector<std::vector<std::int64_t>>& inputs) {
+  // Worker threads don't survive fork(), so the child needs its own pool.
+  CHECK(Dies([&] {
+    ThreadPool pool(1);
+    RunLockstep(&pool, program, inputs);
+  }));
+  CHECK(Dies([&] {
+    ThreadPool pool(1);
+    RunBatch(&pool, program, inputs);
+  }));
+}
+
+// The number of machines in the larger batches: a prime, so that the last
+// group isn't full.
+constexpr int kBatchSize = 97;
+
+void TestDivergentBranches(std::mt19937_64& rng) {
+  std::uniform_int_distribution<std::int64_t> n(0, 30);
+  std::uniform_int_distribution<std::int64_t> k(-5, 30);
+  std::vector<std::vector<std::int64_t>> inputs;
+  for (int i = 0; i < kBatchSize; ++i) {
+    // Some machines get too little input and stop waiting for more.
+    switch (i % 10) {
+      case 0:
+        inputs.push_back({});
+        break;
+      case 1:
+        inputs.push_back({n(rng)});
+        break;
+      default:
+        inputs.push_back({n(rng), k(rng)});
+        break;
+    }
+  }
+  CheckMatchesBatch(kBranchy, inputs);
+}
+
+void TestSelfModifyingCode(std::mt19937_64& rng) {
+  constexpr std::int64_t kOps[] = {1101, 1102, 1107, 1108};
+  std::uniform_int_distribution<int> op(0, 3);
+  std::uniform_int_distribution<std::int64_t> operand(-20, 20);
+  std::vector<std::vector<std::int64_t>> inputs;
+  for (int i = 0; i < kBatchSize; ++i) {
+    // Neighbouring machines often run the same instruction.
+    std::vector<std::int64_t>& lane_inputs = inputs.emplace_back();
+    lane_inputs.push_back(kOps[i % 3 == 0 ? op(rng) : 0]);
+    const int num_operands = i % 7;
+    for (int j = 0; j < num_operands; ++j) lane_inputs.push_back(operand(rng));
+    if (i % 5 != 0) lane_inputs.push_back(0);
+  }
+  CheckMatchesBatch(kSelfModifying, inputs);
+
+  // Each machine's primes are different, so are the instructions the sieve
+  // rewrites.
+  const std::vector<std::int64_t> sieve =
+      ReadIntcodeProgram("cc/util/testdata/self_modifying_sieve.txt");
+  std::vector<std::vector<std::int64_t>> limits;
+  for (int i = 0; i < 21; ++i) limits.push_back({i * i % 101});
+  CheckMatchesBatch(sieve, limits);
+}
+
+void TestEjectedMachines(std::mt19937_64& rng) {
+  // Offsets past the lockstep memory limit, but fine for IntcodeMachine.
+  const std::int64_t kFarOffsets[] = {70000, std::int64_t{1} << 40};
+  std::uniform_int_distribution<std::int64_t> near(20, 60);
+  std::uniform_int_distribution<std::int64_t> value(-1000, 1000);
+  std::vector<std::vector<std::int64_t>> inputs;
+  for (int i = 0; i < kBatchSize; ++i) {
+    const std::int64_t offset = i % 4 == 1 ? kFarOffsets[i % 8 / 4] : near(rng);
+    inputs.push_back({offset, value(rng), i % 6 == 0 ? 1 : 0});
+  }
+  CheckMatchesBatch(kFarStores, inputs);
+
+  // One machine in a group stores to a negative address...
+  std::vector<std::vector<std::int64_t>> negative(11, {25, 1, 0});
+  negative[9] = {-100, 1, 0};
+  CheckBothDie(kFarStores, negative);
+  // ...or runs an illegal instruction.
+  std::vector<std::vector<std::int64_t>> illegal(11, {1101, 1, 0});
+  illegal[6] = {1103, 1, 0};
+  CheckBothDie(kSelfModifying, illegal);
+}
+
+void TestArithmetic(std::mt19937_64& rng) {
+  // Products of these still fit in 64 bits.
+  std::uniform_int_distribution<std::int64_t> word(-(std::int64_t{1} << 31),
+                                                   std::int64_t{1} << 31);
+  std::uniform_int_distribution<std::int64_t> small(-3, 3);
+  std::vector<std::vector<std::int64_t>> inputs;
+  for (int i = 0; i < kBatchSize; ++i) {
+    std::vector<std::int64_t>& lane_inputs = inputs.emplace_back();
+    for (int pair = 0; pair < 10; ++pair) {
+      auto& distribution = pair % 2 == 0 ? word : small;
+      lane_inputs.push_back(distribution(rng));
+      lane_inputs.push_back(pair % 3 == 0 ? lane_inputs.back()
+                                          : distribution(rng));
+    }
+  }
+  CheckMatchesBatch(kArithmetic, inputs);
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  std::mt19937_64 rng(2019);
+  aoc2019::TestDivergentBranches(rng);
+  aoc2019::TestSelfModifyingCode(rng);
+  aoc2019::TestEjectedMachines(rng);
+  aoc2019::TestArithmetic(rng);
+  return 0;
+}
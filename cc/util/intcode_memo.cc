@@ -0,0 +1,56 @@
+#include "cc/util/intcode_memo.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_batch.h"
+
+namespace aoc2019 {
+
+IntcodeMemo::IntcodeMemo(const std::vector<std::int64_t>& program,
+                         std::size_t max_bytes)
+    : pristine_(IntcodeMachine(program).Snapshot()), max_bytes_(max_bytes) {}
+
+const BatchResult& IntcodeMemo::Run(absl::Span<const std::int64_t> inputs) {
+  key_.assign(inputs.begin(), inputs.end());
+  if (auto it = cache_.find(key_); it != cache_.end()) {
+    ++hits_;
+    return it->second;
+  }
+  ++misses_;
+
+  if (machine_.has_value()) {
+    machine_->Reset(*pristine_);
+  } else {
+    machine_.emplace(*pristine_);
+  }
+  machine_->PushInputs(inputs);
+  BatchResult result;
+  result.state = machine_->Run(&result.outputs);
+  result.outputs.shrink_to_fit();
+
+  const std::size_t bytes =
+      (key_.size() + result.outputs.size()) * sizeof(std::int64_t);
+  // The table may have to grow to fit another entry.
+  const std::size_t slot_bytes = sizeof(Cache::value_type) + 1;
+  const std::size_t table_bytes =
+      cache_.size() < cache_.capacity() * 7 / 8
+          ? cache_.capacity() * slot_bytes
+          : (2 * cache_.capacity() + 1) * slot_bytes;
+  if (table_bytes + entry_bytes_ + bytes > max_bytes_) {
+    uncached_ = std::move(result);
+    return uncached_;
+  }
+  entry_bytes_ += bytes;
+  return cache_.emplace(key_, std::move(result)).first->second;
+}
+
+std::size_t IntcodeMemo::memory_bytes() const {
+  return cache_.capacity() * (sizeof(Cache::value_type) + 1) + entry_bytes_;
+}
+
+}  // namespace aoc2019
@@ -0,0 +1,72 @@
+#ifndef CC_UTIL_INTCODE_MEMO_H_
+#define CC_UTIL_INTCODE_MEMO_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_batch.h"
+
+namespace aoc2019 {
+
+// Runs a program from its initial state on one set of inputs at a time,
+// caching the result of every run. Every run starts from the same memory, so
+// the result depends only on the inputs and repeated inputs are answered
+// from the cache without running anything. This suits programs like puzzle
+// 19's, which callers probe over and over with overlapping inputs.
+class IntcodeMemo {
+ public:
+  // Stops caching new results once the cache uses about 'max_bytes'. Results
+  // already cached are kept.
+  explicit IntcodeMemo(const std::vector<std::int64_t>& program,
+                       std::size_t max_bytes = std::size_t{64} << 20);
+
+  IntcodeMemo(const IntcodeMemo&) = delete;
+  IntcodeMemo& operator=(const IntcodeMemo&) = delete;
+
+  // Returns the result of running the program on 'inputs' until it halts or
+  // needs more input. The reference is valid until the next call.
+  const BatchResult& Run(absl::Span<const std::int64_t> inputs);
+
+  // Calls to Run() answered from the cache, and calls that ran the program.
+  std::uint64_t hits() const { return hits_; }
+  std::uint64_t misses() const { return misses_; }
+
+  // Returns the fraction of calls to Run() answered from the cache, or 0 if
+  // there were none.
+  double hit_rate() const {
+    const std::uint64_t calls = hits_ + misses_;
+    return calls == 0 ? 0.0 : static_cast<double>(hits_) / calls;
+  }
+
+  // Returns the approximate memory used by the cache.
+  std::size_t memory_bytes() const;
+
+ private:
+  using Cache = absl::flat_hash_map<std::vector<std::int64_t>, BatchResult>;
+
+  const std::shared_ptr<const IntcodeMachine> pristine_;
+  const std::size_t max_bytes_;
+
+  Cache cache_;
+  // Heap memory owned by the keys and values in 'cache_'.
+  std::size_t entry_bytes_ = 0;
+
+  // Reused by every run, so that buffers only need to be allocated once.
+  std::optional<IntcodeMachine> machine_;
+  std::vector<std::int64_t> key_;
+  // Holds the result of a run that didn't fit in the cache.
+  BatchResult uncached_;
+
+  std::uint64_t hits_ = 0;
+  std::uint64_t misses_ = 0;
+};
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_INTCODE_MEMO_H_
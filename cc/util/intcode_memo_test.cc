@@ -0,0 +1,91 @@
+// Checks that IntcodeMemo returns the same results as running the program,
+// counts hits and misses, and stops caching at its memory limit.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cc/util/check.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_batch.h"
+#include "cc/util/intcode_memo.h"
+
+namespace aoc2019 {
+namespace {
+
+const std::vector<std::int64_t>& Sieve() {
+  static const std::vector<std::int64_t>* const program =
+      new std::vector<std::int64_t>(
+          ReadIntcodeProgram("cc/util/testdata/self_modifying_sieve.txt"));
+  return *program;
+}
+
+// Checks that 'result' is what running the sieve on 'inputs' gives.
+void CheckMatchesRun(const BatchResult& result,
+                     const std::vector<std::int64_t>& inputs) {
+  IntcodeMachine machine(Sieve());
+  machine.PushInputs(inputs);
+  std::vector<std::int64_t> outputs;
+  CHECK(result.state == machine.Run(&outputs));
+  CHECK(result.outputs == outputs);
+}
+
+void TestHitsAndMisses() {
+  IntcodeMemo memo(Sieve());
+  CHECK(memo.hit_rate() == 0);
+  // Inputs that end waiting for more input are cached too, and are distinct
+  // from their extensions.
+  const std::vector<std::vector<std::int64_t>> inputs = {
+      {100}, {50}, {100}, {}, {50}, {100}, {}, {100, 7}};
+  const bool expect_hit[] = {false, false, true, false,
+                             true,  true,  true, false};
+  std::uint64_t expected_hits = 0;
+  for (std::size_t i = 0; i < inputs.size(); ++i) {
+    CheckMatchesRun(memo.Run(inputs[i]), inputs[i]);
+    if (expect_hit[i]) ++expected_hits;
+    CHECK(memo.hits() == expected_hits);
+    CHECK(memo.misses() == i + 1 - expected_hits);
+  }
+  CHECK(memo.hit_rate() == 4.0 / 8);
+  CHECK(memo.memory_bytes() > 0);
+}
+
+void TestMaxBytes() {
+  constexpr std::size_t kMaxBytes = 8192;
+  IntcodeMemo memo(Sieve(), kMaxBytes);
+  constexpr int kNumInputs = 500;
+  for (std::int64_t n = 0; n < kNumInputs; ++n) {
+    CheckMatchesRun(memo.Run({n}), {n});
+    CHECK(memo.memory_bytes() <= kMaxBytes);
+  }
+  CHECK(memo.misses() == kNumInputs);
+
+  // The first results stay cached; the last ones didn't fit.
+  CheckMatchesRun(memo.Run({0}), {0});
+  CHECK(memo.hits() == 1);
+  CheckMatchesRun(memo.Run({kNumInputs - 1}), {kNumInputs - 1});
+  CHECK(memo.hits() == 1);
+  std::uint64_t hits = 0;
+  for (std::int64_t n = 0; n < kNumInputs; ++n) {
+    const std::uint64_t hits_before = memo.hits();
+    CheckMatchesRun(memo.Run({n}), {n});
+    hits += memo.hits() - hits_before;
+  }
+  CHECK(hits > 0 && hits < kNumInputs);
+  CHECK(memo.memory_bytes() <= kMaxBytes);
+
+  // With no room at all, nothing is cached.
+  IntcodeMemo uncached(Sieve(), 0);
+  for (int i = 0; i < 3; ++i) CheckMatchesRun(uncached.Run({30}), {30});
+  CHECK(uncached.hits() == 0);
+  CHECK(uncached.misses() == 3);
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  aoc2019::TestHitsAndMisses();
+  aoc2019::TestMaxBytes();
+  return 0;
+}
@@ -0,0 +1,158 @@
+#include "cc/util/intcode_memory.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "absl/numeric/int128.h"
+#include "absl/types/span.h"
+#include "cc/util/check.h"
+#include "cc/util/intcode_profile.h"
+
+namespace aoc2019 {
+
+template <typename Word>
+BasicIntcodeMemory<Word>::BasicIntcodeMemory(absl::Span<const Word> contents) {
+  const std::uint64_t num_pages =
+      (contents.size() + kPageSize - 1) >> kPageBits;
+  table_.reserve(num_pages);
+  pages_.reserve(num_pages);
+  for (std::uint64_t page = 0; page < num_pages; ++page) {
+    auto data = std::make_shared<Page>();
+    const absl::Span<const Word> chunk =
+        contents.subspan(page * kPageSize, kPageSize);
+    std::copy(chunk.begin(), chunk.end(), data->begin());
+    std::fill(data->begin() + chunk.size(), data->end(), 0);
+    table_.push_back(PageEntry{data->data(), data->data()});
+    pages_.push_back(std::move(data));
+  }
+}
+
+template <typename Word>
+BasicIntcodeMemory<Word>::BasicIntcodeMemory(const BasicIntcodeMemory& other)
+    : pages_(other.pages_), sparse_pages_(other.sparse_pages_) {
+  for (PageEntry& entry : other.table_) {
+    if (entry.write != nullptr) entry.write = nullptr;
+  }
+  table_ = other.table_;
+}
+
+template <typename Word>
+BasicIntcodeMemory<Word>& BasicIntcodeMemory<Word>::operator=(
+    const BasicIntcodeMemory& other) {
+  if (this != &other) {
+    BasicIntcodeMemory copy(other);
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+template <typename Word>
+void BasicIntcodeMemory<Word>::Reset(const BasicIntcodeMemory& other) {
+  if (this == &other) return;
+  if (table_.size() < other.table_.size()) {
+    table_.resize(other.table_.size(), PageEntry{ZeroPage().data(), nullptr});
+    pages_.resize(other.table_.size());
+  }
+  for (std::uint64_t page = 0; page < table_.size(); ++page) {
+    PageEntry& entry = table_[page];
+    const Word* const source = page < other.table_.size()
+                                   ? other.table_[page].read
+                                   : ZeroPage().data();
+    if (entry.write != nullptr) {
+      std::copy(source, source + kPageSize, entry.write);
+    } else if (page < other.table_.size()) {
+      // Leaves frozen memories untouched, as the copy constructor does.
+      if (other.table_[page].write != nullptr) {
+        other.table_[page].write = nullptr;
+      }
+      entry.read = source;
+      pages_[page] = other.pages_[page];
+    } else {
+      entry.read = source;
+      pages_[page] = nullptr;
+    }
+  }
+  sparse_pages_ = other.sparse_pages_;
+}
+
+template <typename Word>
+bool BasicIntcodeMemory<Word>::ReserveTable(std::uint64_t size) {
+  const std::uint64_t num_pages = (size + kPageSize - 1) >> kPageBits;
+  if (num_pages > kMaxTablePages) return false;
+  if (num_pages > table_.size()) {
+    table_.resize(num_pages, PageEntry{ZeroPage().data(), nullptr});
+    pages_.resize(num_pages);
+  }
+  return true;
+}
+
+template <typename Word>
+const typename BasicIntcodeMemory<Word>::Page&
+BasicIntcodeMemory<Word>::ZeroPage() {
+  static const Page* const page = new Page{};
+  return *page;
+}
+
+template <typename Word>
+Word BasicIntcodeMemory<Word>::LoadSlow(std::uint64_t address) const {
+  if (address >= kMaxAddress) {
+    std::cerr << "Negative memory address: "
+              << static_cast<std::int64_t>(address) << "\n";
+    CHECK(false);
+  }
+  const std::uint64_t page = address >> kPageBits;
+  if (page < kMaxTablePages) return 0;
+  const auto it = sparse_pages_.find(page);
+  if (it == sparse_pages_.end()) return 0;
+  return (*it->second)[address & (kPageSize - 1)];
+}
+
+template <typename Word>
+void BasicIntcodeMemory<Word>::MakeExclusive(std::shared_ptr<Page>* data) {
+  if (*data == nullptr) {
+    if constexpr (kIntcodeProfile) {
+      IntcodeProfile::ForThread().CountPageAllocation();
+    }
+    *data = std::make_shared<Page>();
+    (*data)->fill(0);
+  } else if (data->use_count() > 1) {
+    if constexpr (kIntcodeProfile) IntcodeProfile::ForThread().CountPageCopy();
+    *data = std::make_shared<Page>(**data);
+  }
+  // Otherwise every other memory sharing the page is gone, so it can be
+  // written in place.
+}
+
+template <typename Word>
+void BasicIntcodeMemory<Word>::StoreSlow(std::uint64_t address, Word value) {
+  if (address >= kMaxAddress) {
+    std::cerr << "Negative memory address: "
+              << static_cast<std::int64_t>(address) << "\n";
+    CHECK(false);
+  }
+  const std::uint64_t page = address >> kPageBits;
+  if (page >= kMaxTablePages) {
+    std::shared_ptr<Page>& data = sparse_pages_[page];
+    MakeExclusive(&data);
+    (*data)[address & (kPageSize - 1)] = value;
+    return;
+  }
+  if (page >= table_.size()) {
+    table_.resize(page + 1, PageEntry{ZeroPage().data(), nullptr});
+    pages_.resize(page + 1);
+  }
+
+  std::shared_ptr<Page>& data = pages_[page];
+  MakeExclusive(&data);
+  table_[page] = PageEntry{data->data(), data->data()};
+  (*data)[address & (kPageSize - 1)] = value;
+}
+
+template class BasicIntcodeMemory<std::int32_t>;
+template class BasicIntcodeMemory<std::int64_t>;
+template class BasicIntcodeMemory<absl::int128>;
+
+}  // namespace aoc2019
@@ -0,0 +1,134 @@
+#ifndef CC_UTIL_INTCODE_MEMORY_H_
+#define CC_UTIL_INTCODE_MEMORY_H_
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/numeric/int128.h"
+#include "absl/types/span.h"
+
+namespace aoc2019 {
+
+// The address space of an Intcode machine, split into fixed-size pages that
+// copies share until one of them writes. Every address starts out holding 0;
+// pages are only allocated once something nonzero might be stored in them.
+// Pages at low addresses (where programs normally keep everything) are found
+// through a flat table; the rest are kept in a hash map, so that storing to a
+// huge address only costs the page that holds it.
+//
+// Copying an IntcodeMemory copies the page table, not the pages, so its cost
+// is proportional to the number of pages rather than to their contents. The
+// copy constructor also marks the source's pages shared, so it must not run
+// concurrently with any other use of the source. Copies whose pages are all
+// shared (e.g. one that is never written after being copied) are never
+// modified by being copied again, so a frozen copy may be copied from any
+// number of threads at once.
+//
+// 'Word' is the type of a memory cell: std::int32_t, std::int64_t or
+// absl::int128. Addresses are 64-bit whatever the word size.
+template <typename Word>
+class BasicIntcodeMemory {
+ public:
+  static constexpr int kPageBits = 9;
+  static constexpr std::uint64_t kPageSize = std::uint64_t{1} << kPageBits;
+
+  // Addresses at or beyond this (i.e. negative ones) are invalid.
+  static constexpr std::uint64_t kMaxAddress = std::uint64_t{1} << 63;
+
+  // Pages below this are in the page table. The table grows to cover the
+  // highest one written, so this bounds it at 1 MiB.
+  static constexpr std::uint64_t kMaxTablePages = std::uint64_t{1} << 16;
+
+  // Compiled code indexes the page table directly, so the layout is fixed.
+  // 'write' is null unless the page is owned exclusively by this memory.
+  struct PageEntry {
+    const Word* read;
+    Word* write;
+  };
+  static_assert(sizeof(PageEntry) == 16, "PageEntry must be 16 bytes");
+
+  BasicIntcodeMemory() = default;
+  explicit BasicIntcodeMemory(absl::Span<const Word> contents);
+
+  BasicIntcodeMemory(const BasicIntcodeMemory& other);
+  BasicIntcodeMemory& operator=(const BasicIntcodeMemory& other);
+
+  BasicIntcodeMemory(BasicIntcodeMemory&& other) noexcept = default;
+  BasicIntcodeMemory& operator=(BasicIntcodeMemory&& other) noexcept = default;
+
+  // Makes this memory's contents equal to 'other's, like assignment, but
+  // keeps the pages this memory owns exclusively and overwrites them in
+  // place, rather than sharing 'other's and copying them again on the next
+  // write. Owned pages that 'other' doesn't have are zeroed and kept too, so
+  // resetting a memory between runs of a program stops allocating once it
+  // has owned every page the runs write. Like copying, this revokes write
+  // access to 'other's pages that this memory now shares.
+  void Reset(const BasicIntcodeMemory& other);
+
+  Word Load(std::uint64_t address) const {
+    const std::uint64_t page = address >> kPageBits;
+    if (ABSL_PREDICT_FALSE(page >= table_.size())) return LoadSlow(address);
+    return table_[page].read[address & (kPageSize - 1)];
+  }
+
+  void Store(std::uint64_t address, Word value) {
+    const std::uint64_t page = address >> kPageBits;
+    if (ABSL_PREDICT_TRUE(page < table_.size() &&
+                          table_[page].write != nullptr)) {
+      table_[page].write[address & (kPageSize - 1)] = value;
+      return;
+    }
+    StoreSlow(address, value);
+  }
+
+  // Like Load(), but 'address' must be below the size most recently passed
+  // to ReserveTable().
+  Word LoadUnchecked(std::uint64_t address) const {
+    return table_[address >> kPageBits].read[address & (kPageSize - 1)];
+  }
+
+  // Extends the page table to cover every address below 'size', without
+  // allocating any pages. Returns false, doing nothing, if that would need
+  // more than kMaxTablePages pages.
+  bool ReserveTable(std::uint64_t size);
+
+  const PageEntry* page_table() const { return table_.data(); }
+  std::uint64_t num_pages() const { return table_.size(); }
+
+ private:
+  using Page = std::array<Word, kPageSize>;
+
+  // Shared by every unallocated page.
+  static const Page& ZeroPage();
+
+  Word LoadSlow(std::uint64_t address) const;
+
+  // Makes the page holding 'address' writable, then stores to it.
+  void StoreSlow(std::uint64_t address, Word value);
+
+  // Points 'data' at a page that no other memory shares, allocating or copying
+  // one if necessary.
+  static void MakeExclusive(std::shared_ptr<Page>* data);
+
+  // Mutable because copying revokes write access to shared pages.
+  mutable std::vector<PageEntry> table_;
+  // Parallel to 'table_'. Null for pages that still read from ZeroPage().
+  std::vector<std::shared_ptr<Page>> pages_;
+  // Pages at or beyond kMaxTablePages that have been written, keyed by page
+  // number.
+  absl::flat_hash_map<std::uint64_t, std::shared_ptr<Page>> sparse_pages_;
+};
+
+extern template class BasicIntcodeMemory<std::int32_t>;
+extern template class BasicIntcodeMemory<std::int64_t>;
+extern template class BasicIntcodeMemory<absl::int128>;
+
+using IntcodeMemory = BasicIntcodeMemory<std::int64_t>;
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_INTCODE_MEMORY_H_
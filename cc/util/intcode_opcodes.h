@@ -0,0 +1,64 @@
+#ifndef CC_UTIL_INTCODE_OPCODES_H_
+#define CC_UTIL_INTCODE_OPCODES_H_
+
+#include <algorithm>
+#include <cstdint>
+
+namespace aoc2019 {
+
+// The shape of each Intcode operation, shared by the interpreter and by the
+// libraries that analyze, batch, compile or transpile programs, so that they
+// all agree on which opcodes exist. Not meant for use outside cc/util.
+
+// Divisors that extract the addressing mode digit of each parameter.
+inline constexpr std::int64_t kModeDivisors[] = {100, 1000, 10000};
+
+// Returns the number of parameters taken by 'op', or -1 if 'op' is not a
+// known operation.
+constexpr int ParamCount(std::int64_t op) {
+  switch (op) {
+    case 1:
+    case 2:
+    case 7:
+    case 8:
+      return 3;
+    case 5:
+    case 6:
+      return 2;
+    case 3:
+    case 4:
+    case 9:
+      return 1;
+    case 99:
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+// Returns the number of words taken by 'instruction', counting malformed
+// instructions as a single word.
+constexpr int InstructionLength(std::int64_t instruction) {
+  if (instruction < 0) return 1;
+  return std::max(ParamCount(instruction % 100), 0) + 1;
+}
+
+// Returns the index of the parameter that 'op' stores to, or -1 if it doesn't
+// store anything.
+constexpr int StoreParam(std::int64_t op) {
+  switch (op) {
+    case 1:
+    case 2:
+    case 7:
+    case 8:
+      return 2;
+    case 3:
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_INTCODE_OPCODES_H_
@@ -0,0 +1,103 @@
+// Checks that IntcodeOutputs pulls a machine's outputs one at a time, and
+// that state() tells a machine waiting for input from one that halted.
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "cc/util/check.h"
+#include "cc/util/intcode.h"
+
+namespace aoc2019 {
+namespace {
+
+using ExecState = IntcodeMachine::ExecState;
+
+// Reads x and outputs 2x then x, until it reads 0.
+const std::vector<std::int64_t> kDoubler = {
+    3, 50,              // x = input
+    1002, 50, 2, 51,    // y = 2x
+    4, 51,              // output y
+    4, 50,              // output x
+    1005, 50, 0,        // if x != 0 goto 0
+    99};
+
+void TestPendingInputThenHalt() {
+  IntcodeMachine machine(kDoubler);
+  IntcodeOutputs<std::int64_t> outputs(&machine);
+  CHECK(!outputs.Next().has_value());
+  CHECK(outputs.state() == ExecState::kPendingInput);
+
+  machine.PushInputs({3, 4});
+  CHECK(outputs.Next() == std::optional<std::int64_t>(6));
+  CHECK(outputs.state() == ExecState::kOutput);
+  // Nothing runs ahead of the outputs pulled so far.
+  CHECK(machine.ReadMemory(50) == 3);
+  CHECK(outputs.NextOrDie() == 3);
+  CHECK(outputs.NextOrDie() == 8);
+  CHECK(machine.ReadMemory(50) == 4);
+  CHECK(outputs.Next() == std::optional<std::int64_t>(4));
+  CHECK(!outputs.Next().has_value());
+  CHECK(outputs.state() == ExecState::kPendingInput);
+  // Still waiting until input arrives.
+  CHECK(!outputs.Next().has_value());
+  CHECK(outputs.state() == ExecState::kPendingInput);
+
+  machine.PushInputs({5, 0});
+  std::vector<std::int64_t> rest;
+  for (const std::int64_t output : outputs) rest.push_back(output);
+  CHECK(rest == std::vector<std::int64_t>({10, 5, 0, 0}));
+  CHECK(outputs.state() == ExecState::kHalt);
+  CHECK(!outputs.Next().has_value());
+  CHECK(outputs.state() == ExecState::kHalt);
+}
+
+void TestIteration() {
+  // The range stops at input that hasn't arrived yet, and a new range picks
+  // up from there.
+  IntcodeMachine machine(kDoubler);
+  machine.PushInputs({1, 2});
+  IntcodeOutputs<std::int64_t> outputs(&machine);
+  std::vector<std::int64_t> pulled(outputs.begin(), outputs.end());
+  CHECK(pulled == std::vector<std::int64_t>({2, 1, 4, 2}));
+  CHECK(outputs.state() == ExecState::kPendingInput);
+  CHECK(outputs.begin() == outputs.end());
+
+  machine.PushInputs({0});
+  pulled.assign(outputs.begin(), outputs.end());
+  CHECK(pulled == std::vector<std::int64_t>({0, 0}));
+  CHECK(outputs.state() == ExecState::kHalt);
+}
+
+void TestInputSource() {
+  // Inputs are only requested when the program reads them.
+  IntcodeMachine machine(kDoubler);
+  const std::vector<std::int64_t> inputs = {7, -1, 0};
+  std::size_t num_read = 0;
+  machine.SetInputSource([&]() -> std::optional<std::int64_t> {
+    if (num_read == inputs.size()) return std::nullopt;
+    return inputs[num_read++];
+  });
+  IntcodeOutputs<std::int64_t> outputs(&machine);
+  CHECK(outputs.NextOrDie() == 14);
+  CHECK(num_read == 1);
+  CHECK(outputs.NextOrDie() == 7);
+  CHECK(num_read == 1);
+  CHECK(outputs.NextOrDie() == -2);
+  CHECK(num_read == 2);
+  std::vector<std::int64_t> rest(outputs.begin(), outputs.end());
+  CHECK(rest == std::vector<std::int64_t>({-1, 0, 0}));
+  CHECK(outputs.state() == ExecState::kHalt);
+  CHECK(num_read == 3);
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  aoc2019::TestPendingInputThenHalt();
+  aoc2019::TestIteration();
+  aoc2019::TestInputSource();
+  return 0;
+}
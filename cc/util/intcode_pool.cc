@@ -0,0 +1,37 @@
+#include "cc/util/intcode_pool.h"
+
+#include <cstdint>
+#include <utility>
+
+#include "absl/numeric/int128.h"
+#include "cc/util/intcode.h"
+
+namespace aoc2019 {
+
+template <typename Word>
+BasicIntcodeMachinePool<Word>& BasicIntcodeMachinePool<Word>::ForThread() {
+  thread_local BasicIntcodeMachinePool pool;
+  return pool;
+}
+
+template <typename Word>
+BasicIntcodeMachine<Word> BasicIntcodeMachinePool<Word>::Acquire(
+    const BasicIntcodeMachine<Word>& source) {
+  if (idle_.empty()) return source.Fork();
+  BasicIntcodeMachine<Word> machine = std::move(idle_.back());
+  idle_.pop_back();
+  machine.Reset(source);
+  return machine;
+}
+
+template <typename Word>
+void BasicIntcodeMachinePool<Word>::Release(
+    BasicIntcodeMachine<Word>&& machine) {
+  if (idle_.size() < kMaxIdle) idle_.push_back(std::move(machine));
+}
+
+template class BasicIntcodeMachinePool<std::int32_t>;
+template class BasicIntcodeMachinePool<std::int64_t>;
+template class BasicIntcodeMachinePool<absl::int128>;
+
+}  // namespace aoc2019
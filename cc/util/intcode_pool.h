@@ -0,0 +1,55 @@
+#ifndef CC_UTIL_INTCODE_POOL_H_
+#define CC_UTIL_INTCODE_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/numeric/int128.h"
+#include "cc/util/intcode.h"
+
+namespace aoc2019 {
+
+// Machines that are no longer needed, kept so that new machines can reuse
+// their buffers (see BasicIntcodeMachine::Reset()) rather than allocating
+// their own. Code that forks a machine for every probe, like puzzle 15's
+// search, can release each fork once it is done with it and stop allocating
+// once the pool holds as many machines as it ever has alive at once.
+//
+// A pool is not thread-safe; ForThread() gives every thread its own.
+template <typename Word>
+class BasicIntcodeMachinePool {
+ public:
+  // Idle machines beyond this many are destroyed when released.
+  static constexpr std::size_t kMaxIdle = 1024;
+
+  // Returns the calling thread's pool.
+  static BasicIntcodeMachinePool& ForThread();
+
+  BasicIntcodeMachinePool() = default;
+
+  BasicIntcodeMachinePool(const BasicIntcodeMachinePool&) = delete;
+  BasicIntcodeMachinePool& operator=(const BasicIntcodeMachinePool&) = delete;
+
+  // Returns a machine in the same state as 'source', as source.Fork() would,
+  // reset from an idle machine if there is one.
+  BasicIntcodeMachine<Word> Acquire(const BasicIntcodeMachine<Word>& source);
+
+  // Keeps 'machine' for a later Acquire().
+  void Release(BasicIntcodeMachine<Word>&& machine);
+
+  std::size_t num_idle() const { return idle_.size(); }
+
+ private:
+  std::vector<BasicIntcodeMachine<Word>> idle_;
+};
+
+extern template class BasicIntcodeMachinePool<std::int32_t>;
+extern template class BasicIntcodeMachinePool<std::int64_t>;
+extern template class BasicIntcodeMachinePool<absl::int128>;
+
+using IntcodeMachinePool = BasicIntcodeMachinePool<std::int64_t>;
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_INTCODE_POOL_H_
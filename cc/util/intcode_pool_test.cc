@@ -0,0 +1,157 @@
+// Checks that IntcodeMachinePool hands out machines in exactly the state
+// Fork() would, whatever the released machine was doing, that reusing a
+// machine doesn't allocate, and that the pool keeps at most kMaxIdle
+// machines.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cc/util/check.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_pool.h"
+
+namespace {
+
+// Heap allocations so far, counted by the replacement operator new below.
+std::atomic<std::size_t> num_allocations{0};
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  ++num_allocations;
+  void* const p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t /*size*/) noexcept { std::free(p); }
+
+namespace aoc2019 {
+namespace {
+
+// Loops reading x, adding it to the relative base, incrementing the word
+// there and outputting it, then incrementing and outputting a counter. Its
+// outputs depend on its pc, relative base, memory and queued inputs.
+const std::vector<std::int64_t> kProbe = {
+    3, 100,              // x = input
+    9, 100,              // rb += x
+    21201, 0, 1, 0,      // mem[rb] += 1
+    204, 0,              // output mem[rb]
+    1001, 101, 1, 101,   // count += 1
+    4, 101,              // output count
+    1105, 1, 0};
+
+// Checks that 'a' and 'b' hold the same memory and behave the same from now
+// on.
+void CheckSameState(IntcodeMachine* a, IntcodeMachine* b) {
+  for (std::uint64_t address = 0; address < 2048; ++address) {
+    CHECK(a->ReadMemory(address) == b->ReadMemory(address));
+  }
+  for (const std::vector<std::int64_t>& inputs :
+       {std::vector<std::int64_t>{}, {-5, 0, 7}, {600, -3}}) {
+    a->PushInputs(inputs);
+    b->PushInputs(inputs);
+    std::vector<std::int64_t> a_outputs;
+    std::vector<std::int64_t> b_outputs;
+    CHECK(a->Run(&a_outputs) == b->Run(&b_outputs));
+    CHECK(a_outputs == b_outputs);
+  }
+}
+
+void TestAcquireMatchesFork() {
+  // A source partway through a run, with a nonzero relative base, memory it
+  // has written and an input still queued.
+  IntcodeMachine source(kProbe);
+  source.PushInputs({150, 7, -7});
+  std::vector<std::int64_t> outputs;
+  CHECK(source.Run(&outputs) ==
+        IntcodeMachine::ExecState::kPendingInput);
+  source.PushInputs({5});
+
+  IntcodeMachinePool pool;
+  // A machine released in the middle of a different program, with inputs
+  // it never read.
+  const std::vector<std::int64_t> sieve =
+      ReadIntcodeProgram("cc/util/testdata/self_modifying_sieve.txt");
+  IntcodeMachine used(sieve);
+  used.PushInputs({200});
+  CHECK(used.RunFor(500, [](std::int64_t) {}) ==
+        IntcodeMachine::ExecState::kBudgetExhausted);
+  used.PushInputs({1, 2, 3});
+  pool.Release(std::move(used));
+  CHECK(pool.num_idle() == 1);
+
+  IntcodeMachine acquired = pool.Acquire(source);
+  CHECK(pool.num_idle() == 0);
+  IntcodeMachine forked = source.Fork();
+  CheckSameState(&acquired, &forked);
+
+  // With nothing idle, Acquire() forks.
+  IntcodeMachine fresh = pool.Acquire(source);
+  IntcodeMachine forked_again = source.Fork();
+  CheckSameState(&fresh, &forked_again);
+}
+
+void TestReuseDoesNotAllocate() {
+  const IntcodeMachine source(
+      ReadIntcodeProgram("cc/util/testdata/self_modifying_sieve.txt"));
+  IntcodeMachinePool pool;
+  std::int64_t expected_sum = 0;
+  for (int run = 0; run < 3; ++run) {
+    const std::size_t allocations_before = num_allocations;
+    IntcodeMachine machine = pool.Acquire(source);
+    machine.PushInputs({300});
+    std::int64_t sum = 0;
+    machine.Run([&sum](std::int64_t prime) { sum += prime; });
+    // The first run allocates its machine; later ones reuse it.
+    CHECK((num_allocations == allocations_before) == (run > 0));
+    if (run == 0) expected_sum = sum;
+    CHECK(sum == expected_sum);
+    pool.Release(std::move(machine));
+  }
+}
+
+void TestMaxIdle() {
+  const IntcodeMachine source(kProbe);
+  IntcodeMachinePool pool;
+  for (std::size_t i = 0; i < IntcodeMachinePool::kMaxIdle + 10; ++i) {
+    pool.Release(source.Fork());
+  }
+  CHECK(pool.num_idle() == IntcodeMachinePool::kMaxIdle);
+  std::vector<IntcodeMachine> acquired;
+  for (std::size_t i = 0; i < IntcodeMachinePool::kMaxIdle + 10; ++i) {
+    acquired.push_back(pool.Acquire(source));
+  }
+  CHECK(pool.num_idle() == 0);
+  for (IntcodeMachine& machine : acquired) pool.Release(std::move(machine));
+  CHECK(pool.num_idle() == IntcodeMachinePool::kMaxIdle);
+}
+
+void TestForThread() {
+  IntcodeMachinePool* const main_pool = &IntcodeMachinePool::ForThread();
+  CHECK(main_pool == &IntcodeMachinePool::ForThread());
+  IntcodeMachinePool* other_pool = nullptr;
+  std::thread([&other_pool] {
+    other_pool = &IntcodeMachinePool::ForThread();
+  }).join();
+  CHECK(other_pool != main_pool);
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  aoc2019::TestAcquireMatchesFork();
+  aoc2019::TestReuseDoesNotAllocate();
+  aoc2019::TestMaxIdle();
+  aoc2019::TestForThread();
+  return 0;
+}
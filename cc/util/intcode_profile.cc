@@ -0,0 +1,243 @@
+#include "cc/util/intcode_profile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "absl/synchronization/mutex.h"
+#include "cc/util/intcode_opcodes.h"
+
+namespace aoc2019 {
+namespace {
+
+// Rows shown in each table of the text report.
+constexpr int kTopRows = 20;
+
+const char* OperationName(std::int64_t op) {
+  static constexpr const char* kNames[] = {"",   "add", "mul", "in", "out",
+                                           "jt", "jf",  "lt",  "eq", "arb"};
+  if (ParamCount(op) < 0) return "illegal";
+  return op == 99 ? "halt" : kNames[op];
+}
+
+// Returns 'instruction' as an operation name followed by the addressing mode
+// of each parameter, e.g. "add pos imm rel".
+std::string Mnemonic(std::int64_t instruction) {
+  const std::int64_t op = instruction % 100;
+  std::string mnemonic = OperationName(op);
+  for (int param = 0; param < ParamCount(op); ++param) {
+    static constexpr const char* kModeNames[] = {"pos", "imm", "rel"};
+    const std::int64_t mode = instruction / kModeDivisors[param] % 10;
+    absl::StrAppend(&mnemonic, " ", mode < 3 ? kModeNames[mode] : "?");
+  }
+  return mnemonic;
+}
+
+// Returns the nonzero entries of 'counts' with the highest counts first.
+template <typename Key>
+std::vector<std::pair<Key, std::uint64_t>> SortByCount(
+    const absl::flat_hash_map<Key, std::uint64_t>& counts) {
+  std::vector<std::pair<Key, std::uint64_t>> sorted;
+  for (const auto& [key, count] : counts) {
+    if (count != 0) sorted.emplace_back(key, count);
+  }
+  std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+    return a.second != b.second ? a.second > b.second : a.first < b.first;
+  });
+  return sorted;
+}
+
+double Percent(std::uint64_t count, std::uint64_t total) {
+  return total == 0 ? 0.0 : 100.0 * count / total;
+}
+
+std::string JsonCounts(
+    const std::vector<std::pair<std::uint64_t, std::uint64_t>>& counts) {
+  return absl::StrCat(
+      "[",
+      absl::StrJoin(counts, ",",
+                    [](std::string* out, const auto& entry) {
+                      absl::StrAppend(out, "[", entry.first, ",",
+                                      entry.second, "]");
+                    }),
+      "]");
+}
+
+class Registry {
+ public:
+  static Registry& Get() {
+    static Registry* const registry = new Registry();
+    return *registry;
+  }
+
+  void Add(IntcodeProfile* profile) {
+    absl::MutexLock lock(&mutex_);
+    if (profiles_.empty()) std::atexit(&ReportAtExit);
+    profiles_.push_back(profile);
+  }
+
+  template <typename Fn>
+  void ForEach(Fn fn) {
+    absl::MutexLock lock(&mutex_);
+    for (const IntcodeProfile* profile : profiles_) fn(*profile);
+  }
+
+ private:
+  static void ReportAtExit() {
+    const char* format = std::getenv("INTCODE_PROFILE");
+    std::cerr << IntcodeProfile::Report(format != nullptr &&
+                                        std::strcmp(format, "json") == 0);
+  }
+
+  absl::Mutex mutex_;
+  // Never freed, so that threads that have exited still show up in the
+  // report.
+  std::vector<IntcodeProfile*> profiles_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace
+
+IntcodeProfile& IntcodeProfile::ForThread() {
+  thread_local IntcodeProfile* const profile = [] {
+    auto* profile = new IntcodeProfile();
+    Registry::Get().Add(profile);
+    return profile;
+  }();
+  return *profile;
+}
+
+std::string IntcodeProfile::Report(bool json) {
+  // Profiles are only written by their own threads, so this is accurate once
+  // those threads have stopped running machines.
+  IntcodeProfile total;
+  Registry::Get().ForEach(
+      [&total](const IntcodeProfile& profile) { total.Merge(profile); });
+  return json ? total.JsonReport() : total.TextReport();
+}
+
+void IntcodeProfile::Merge(const IntcodeProfile& other) {
+  for (const auto& [instruction, count] : other.instructions_) {
+    instructions_[instruction] += count;
+  }
+  for (const auto& [pc, count] : other.pcs_) pcs_[pc] += count;
+  for (const auto& [pc, counts] : other.jit_blocks_) {
+    JitBlockCounts& merged = jit_blocks_[pc];
+    merged.entries += counts.entries;
+    merged.instructions += counts.instructions;
+  }
+  for (const auto& [pc, count] : other.input_stalls_) {
+    input_stalls_[pc] += count;
+  }
+  fused_pairs_ += other.fused_pairs_;
+  page_allocations_ += other.page_allocations_;
+  page_copies_ += other.page_copies_;
+}
+
+std::string IntcodeProfile::TextReport() const {
+  std::uint64_t interpreted = 0;
+  absl::flat_hash_map<std::int64_t, std::uint64_t> operations;
+  for (const auto& [instruction, count] : instructions_) {
+    interpreted += count;
+    operations[instruction % 100] += count;
+  }
+  std::uint64_t compiled = 0;
+  absl::flat_hash_map<std::uint64_t, std::uint64_t> jit_instructions;
+  for (const auto& [pc, counts] : jit_blocks_) {
+    compiled += counts.instructions;
+    jit_instructions[pc] = counts.instructions;
+  }
+  std::uint64_t stalls = 0;
+  for (const auto& [pc, count] : input_stalls_) stalls += count;
+
+  std::string report = absl::StrFormat(
+      "Intcode profile: %d instructions (%d interpreted in %d dispatches, %d "
+      "compiled)\n"
+      "%d input stalls, %d pages allocated, %d pages copied\n",
+      interpreted + compiled, interpreted, interpreted - fused_pairs_,
+      compiled, stalls, page_allocations_, page_copies_);
+
+  absl::StrAppend(&report, "\nInterpreted operations:\n");
+  for (const auto& [op, count] : SortByCount(operations)) {
+    absl::StrAppendFormat(&report, "  %-8s %14d %6.2f%%\n", OperationName(op),
+                          count, Percent(count, interpreted));
+  }
+
+  absl::StrAppend(&report, "\nInterpreted instructions by addressing mode:\n");
+  int rows = 0;
+  for (const auto& [instruction, count] : SortByCount(instructions_)) {
+    if (rows++ == kTopRows) break;
+    absl::StrAppendFormat(&report, "  %-6d %-16s %14d %6.2f%%\n", instruction,
+                          Mnemonic(instruction), count,
+                          Percent(count, interpreted));
+  }
+
+  absl::StrAppend(&report, "\nHottest interpreted pcs:\n");
+  rows = 0;
+  for (const auto& [pc, count] : SortByCount(pcs_)) {
+    if (rows++ == kTopRows) break;
+    absl::StrAppendFormat(&report, "  %-10d %14d %6.2f%%\n", pc, count,
+                          Percent(count, interpreted));
+  }
+
+  if (!jit_blocks_.empty()) {
+    absl::StrAppend(&report, "\nHottest compiled blocks:\n");
+    rows = 0;
+    for (const auto& [pc, count] : SortByCount(jit_instructions)) {
+      if (rows++ == kTopRows) break;
+      absl::StrAppendFormat(&report,
+                            "  %-10d %14d %6.2f%% in %d entries\n", pc, count,
+                            Percent(count, compiled),
+                            jit_blocks_.at(pc).entries);
+    }
+  }
+
+  if (!input_stalls_.empty()) {
+    absl::StrAppend(&report, "\nInput stalls:\n");
+    rows = 0;
+    for (const auto& [pc, count] : SortByCount(input_stalls_)) {
+      if (rows++ == kTopRows) break;
+      absl::StrAppendFormat(&report, "  %-10d %14d\n", pc, count);
+    }
+  }
+  return report;
+}
+
+std::string IntcodeProfile::JsonReport() const {
+  std::vector<std::string> instructions;
+  for (const auto& [instruction, count] : SortByCount(instructions_)) {
+    instructions.push_back(absl::StrCat("{\"instruction\":", instruction,
+                                        ",\"mnemonic\":\"",
+                                        Mnemonic(instruction),
+                                        "\",\"count\":", count, "}"));
+  }
+  std::vector<std::pair<std::uint64_t, JitBlockCounts>> jit_blocks(
+      jit_blocks_.begin(), jit_blocks_.end());
+  std::sort(jit_blocks.begin(), jit_blocks.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+  std::vector<std::string> blocks;
+  for (const auto& [pc, counts] : jit_blocks) {
+    blocks.push_back(absl::StrCat("{\"pc\":", pc, ",\"entries\":",
+                                  counts.entries, ",\"instructions\":",
+                                  counts.instructions, "}"));
+  }
+  return absl::StrCat(
+      "{\"instructions\":[", absl::StrJoin(instructions, ","),
+      "],\"pcs\":", JsonCounts(SortByCount(pcs_)),
+      ",\"jit_blocks\":[", absl::StrJoin(blocks, ","),
+      "],\"input_stalls\":", JsonCounts(SortByCount(input_stalls_)),
+      ",\"fused_pairs\":", fused_pairs_,
+      ",\"page_allocations\":", page_allocations_,
+      ",\"page_copies\":", page_copies_, "}\n");
+}
+
+}  // namespace aoc2019
@@ -0,0 +1,94 @@
+#ifndef CC_UTIL_INTCODE_PROFILE_H_
+#define CC_UTIL_INTCODE_PROFILE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+
+namespace aoc2019 {
+
+// True if Intcode execution is being profiled, i.e. if built with
+// --define intcode_profile=true. Profiling hooks are guarded by
+// 'if constexpr (kIntcodeProfile)', so they compile to nothing otherwise.
+#ifdef AOC2019_INTCODE_PROFILE
+inline constexpr bool kIntcodeProfile = true;
+#else
+inline constexpr bool kIntcodeProfile = false;
+#endif
+
+// Counts of what Intcode machines on one thread have done. When profiling is
+// enabled, the counts from every thread are merged and reported on stderr at
+// exit: as a table of hot spots, or as JSON if the INTCODE_PROFILE
+// environment variable is "json".
+class IntcodeProfile {
+ public:
+  // Returns the calling thread's profile.
+  static IntcodeProfile& ForThread();
+
+  // Returns the report for every thread's counts so far. 'json' selects the
+  // format.
+  static std::string Report(bool json);
+
+  // Counts an instruction run by the interpreter. 'instruction' is the word
+  // at 'pc', so it holds both the operation and the addressing modes.
+  void CountInstruction(std::uint64_t pc, std::int64_t instruction) {
+    ++instructions_[instruction];
+    ++pcs_[pc];
+  }
+
+  // Takes back a call to CountInstruction() for an instruction that didn't
+  // run after all.
+  void UncountInstruction(std::uint64_t pc, std::int64_t instruction) {
+    --instructions_[instruction];
+    --pcs_[pc];
+  }
+
+  // Counts an entry to the compiled block starting at 'pc' that ran
+  // 'executed' instructions.
+  void CountJitBlock(std::uint64_t pc, std::uint64_t executed) {
+    JitBlockCounts& counts = jit_blocks_[pc];
+    ++counts.entries;
+    counts.instructions += executed;
+  }
+
+  // Counts a pair of instructions that the interpreter ran in one dispatch.
+  // Both are also counted by CountInstruction().
+  void CountFusedPair() { ++fused_pairs_; }
+
+  // Counts an input instruction at 'pc' that found no input.
+  void CountInputStall(std::uint64_t pc) { ++input_stalls_[pc]; }
+
+  // Counts a memory page allocated because something was stored in it.
+  void CountPageAllocation() { ++page_allocations_; }
+
+  // Counts a memory page copied because it was shared when written.
+  void CountPageCopy() { ++page_copies_; }
+
+ private:
+  struct JitBlockCounts {
+    std::uint64_t entries = 0;
+    std::uint64_t instructions = 0;
+  };
+
+  IntcodeProfile() = default;
+
+  // Adds 'other's counts to this one's.
+  void Merge(const IntcodeProfile& other);
+
+  std::string TextReport() const;
+  std::string JsonReport() const;
+
+  // Keyed by instruction word.
+  absl::flat_hash_map<std::int64_t, std::uint64_t> instructions_;
+  absl::flat_hash_map<std::uint64_t, std::uint64_t> pcs_;
+  absl::flat_hash_map<std::uint64_t, JitBlockCounts> jit_blocks_;
+  absl::flat_hash_map<std::uint64_t, std::uint64_t> input_stalls_;
+  std::uint64_t fused_pairs_ = 0;
+  std::uint64_t page_allocations_ = 0;
+  std::uint64_t page_copies_ = 0;
+};
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_INTCODE_PROFILE_H_
@@ -0,0 +1,192 @@
+// Checks that RunUntil() stops on each StopCondition exactly where it says,
+// that calling it again resumes from there, and that the stops don't change
+// what the program outputs, whether or not it is compiled.
+
+#include <cstdint>
+#include <vector>
+
+#include "cc/util/check.h"
+#include "cc/util/intcode.h"
+
+namespace aoc2019 {
+namespace {
+
+using ExecState = IntcodeMachine::ExecState;
+using StopCondition = IntcodeMachine::StopCondition;
+
+constexpr std::uint64_t kA = 100;
+constexpr std::uint64_t kB = 101;
+
+// Counts a and b up together, outputting a between them, until a reaches 5.
+// Each instruction leaves a trace in memory, so a stop shows where it was.
+const std::vector<std::int64_t> kCounter = {
+    1001, kA, 1, kA,     // 0: a += 1
+    1001, kB, 1, kB,     // 4: b += 1
+    4, kA,               // 8: output a
+    1007, kA, 5, 102,    // 10: c = a < 5
+    1005, 102, 0,        // 14: if c goto 0
+    99};                 // 17
+
+// Instructions executed before the halt: 5 on each pass.
+constexpr std::uint64_t kNumInstructions = 5 * 5;
+
+IntcodeMachine NewCounter(bool jit) {
+  IntcodeMachine machine(kCounter);
+  if (jit) machine.EnableJit(1);
+  return machine;
+}
+
+void CheckCounters(const IntcodeMachine& machine, std::int64_t a,
+                   std::int64_t b) {
+  CHECK(machine.ReadMemory(kA) == a);
+  CHECK(machine.ReadMemory(kB) == b);
+}
+
+void TestStopsOnPc(bool jit) {
+  // Before 'b += 1': a has counted each pass, b one fewer.
+  IntcodeMachine machine = NewCounter(jit);
+  StopCondition stop;
+  stop.pc = 4;
+  std::vector<std::int64_t> outputs;
+  for (std::int64_t pass = 1; pass <= 5; ++pass) {
+    CHECK(machine.RunUntil(stop, &outputs) == ExecState::kStopped);
+    CheckCounters(machine, pass, pass - 1);
+    CHECK(outputs.size() == static_cast<std::uint64_t>(pass - 1));
+  }
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kHalt);
+  CHECK(outputs == std::vector<std::int64_t>({1, 2, 3, 4, 5}));
+
+  // The instruction a call starts at doesn't stop it, so the loop head is
+  // only reached by jumping back.
+  IntcodeMachine from_start = NewCounter(jit);
+  stop.pc = 0;
+  outputs.clear();
+  for (std::int64_t pass = 1; pass <= 4; ++pass) {
+    CHECK(from_start.RunUntil(stop, &outputs) == ExecState::kStopped);
+    CheckCounters(from_start, pass, pass);
+  }
+  CHECK(from_start.RunUntil(stop, &outputs) == ExecState::kHalt);
+  CHECK(outputs == std::vector<std::int64_t>({1, 2, 3, 4, 5}));
+
+  // An address never reached.
+  IntcodeMachine unreached = NewCounter(jit);
+  stop.pc = 1;
+  outputs.clear();
+  CHECK(unreached.RunUntil(stop, &outputs) == ExecState::kHalt);
+  CHECK(outputs.size() == 5);
+}
+
+void TestStopsOnOutputs(bool jit) {
+  IntcodeMachine machine = NewCounter(jit);
+  StopCondition stop;
+  stop.num_outputs = 2;
+  std::vector<std::int64_t> outputs;
+  // Right after the output, before the comparison.
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kOutput);
+  CHECK(outputs == std::vector<std::int64_t>({1, 2}));
+  CheckCounters(machine, 2, 2);
+  CHECK(machine.ReadMemory(102) == 1);
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kOutput);
+  CHECK(outputs == std::vector<std::int64_t>({1, 2, 3, 4}));
+  CheckCounters(machine, 4, 4);
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kHalt);
+  CHECK(outputs == std::vector<std::int64_t>({1, 2, 3, 4, 5}));
+
+  IntcodeMachine matching = NewCounter(jit);
+  StopCondition even;
+  even.output_matches = [](std::int64_t output) { return output % 2 == 0; };
+  outputs.clear();
+  CHECK(matching.RunUntil(even, &outputs) == ExecState::kOutput);
+  CHECK(outputs == std::vector<std::int64_t>({1, 2}));
+  CHECK(matching.RunUntil(even, &outputs) == ExecState::kOutput);
+  CHECK(outputs == std::vector<std::int64_t>({1, 2, 3, 4}));
+  CHECK(matching.RunUntil(even, &outputs) == ExecState::kHalt);
+}
+
+void TestStopsOnBudget(bool jit) {
+  // Three instructions: both increments and the output.
+  IntcodeMachine machine = NewCounter(jit);
+  StopCondition stop;
+  stop.max_instructions = 3;
+  std::vector<std::int64_t> outputs;
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kBudgetExhausted);
+  CheckCounters(machine, 1, 1);
+  CHECK(outputs == std::vector<std::int64_t>({1}));
+  // Then the comparison, the jump and the next 'a += 1'.
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kBudgetExhausted);
+  CheckCounters(machine, 2, 1);
+  CHECK(outputs == std::vector<std::int64_t>({1}));
+
+  // Stops in step with RunFor() on the same budget.
+  for (std::uint64_t budget : {1, 2, 7, 25, 26, 100}) {
+    IntcodeMachine until = NewCounter(jit);
+    IntcodeMachine run_for = NewCounter(jit);
+    StopCondition budget_stop;
+    budget_stop.max_instructions = budget;
+    std::vector<std::int64_t> until_outputs;
+    std::vector<std::int64_t> run_for_outputs;
+    std::uint64_t num_calls = 0;
+    ExecState state;
+    do {
+      state = until.RunUntil(budget_stop, &until_outputs);
+      CHECK(state == run_for.RunFor(budget, &run_for_outputs));
+      CHECK(until_outputs == run_for_outputs);
+      ++num_calls;
+    } while (state == ExecState::kBudgetExhausted);
+    CHECK(state == ExecState::kHalt);
+    CHECK(num_calls == kNumInstructions / budget + 1);
+  }
+}
+
+void TestFirstConditionWins(bool jit) {
+  // The budget runs out before the pc is reached on the first call, and the
+  // pc is reached before the budget on the second.
+  IntcodeMachine machine = NewCounter(jit);
+  StopCondition stop;
+  stop.pc = 10;
+  stop.max_instructions = 2;
+  std::vector<std::int64_t> outputs;
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kBudgetExhausted);
+  CheckCounters(machine, 1, 1);
+  CHECK(outputs.empty());
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kStopped);
+  CHECK(outputs == std::vector<std::int64_t>({1}));
+  // The output stops it before the pc does.
+  stop.num_outputs = 1;
+  stop.max_instructions.reset();
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kOutput);
+  CheckCounters(machine, 2, 2);
+  CHECK(outputs == std::vector<std::int64_t>({1, 2}));
+}
+
+void TestPendingInput(bool jit) {
+  // Reads x and outputs it until it reads 0.
+  IntcodeMachine machine({3, 50, 4, 50, 1005, 50, 0, 99});
+  if (jit) machine.EnableJit(1);
+  StopCondition stop;
+  stop.num_outputs = 1;
+  std::vector<std::int64_t> outputs;
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kPendingInput);
+  machine.PushInputs({7, 8});
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kOutput);
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kOutput);
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kPendingInput);
+  machine.PushInputs({0});
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kOutput);
+  CHECK(machine.RunUntil(stop, &outputs) == ExecState::kHalt);
+  CHECK(outputs == std::vector<std::int64_t>({7, 8, 0}));
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  for (const bool jit : {false, true}) {
+    aoc2019::TestStopsOnPc(jit);
+    aoc2019::TestStopsOnOutputs(jit);
+    aoc2019::TestStopsOnBudget(jit);
+    aoc2019::TestFirstConditionWins(jit);
+    aoc2019::TestPendingInput(jit);
+  }
+  return 0;
+}
@@ -0,0 +1,39 @@
+#include "cc/util/intcode_specialize.h"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "cc/util/intcode.h"
+
+namespace aoc2019 {
+namespace {
+
+SpecializedProgram RunPrefix(IntcodeMachine machine,
+                             absl::Span<const std::int64_t> prefix) {
+  SpecializedProgram specialized;
+  machine.PushInputs(prefix);
+  specialized.state = machine.Run(&specialized.outputs);
+  specialized.machine = machine.Snapshot();
+  return specialized;
+}
+
+}  // namespace
+
+SpecializedProgram SpecializeIntcode(const std::vector<std::int64_t>& program,
+                                     absl::Span<const std::int64_t> prefix) {
+  return RunPrefix(IntcodeMachine(program), prefix);
+}
+
+SpecializedProgram IntcodeSpecializer::Specialize(
+    absl::Span<const std::int64_t> prefix) {
+  std::vector<std::int64_t> key(prefix.begin(), prefix.end());
+  if (auto it = cache_.find(key); it != cache_.end()) return it->second;
+  SpecializedProgram specialized = RunPrefix(pristine_->Fork(), prefix);
+  cache_.emplace(std::move(key), specialized);
+  return specialized;
+}
+
+}  // namespace aoc2019
@@ -0,0 +1,51 @@
+#ifndef CC_UTIL_INTCODE_SPECIALIZE_H_
+#define CC_UTIL_INTCODE_SPECIALIZE_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+#include "cc/util/intcode.h"
+
+namespace aoc2019 {
+
+// A program as it stands after being fed a fixed prefix of its input and run
+// as far as it can go without more.
+struct SpecializedProgram {
+  // Paused where the program needs input beyond the prefix (or halted). Fork
+  // it to continue.
+  std::shared_ptr<const IntcodeMachine> machine;
+  // The outputs produced along the way.
+  std::vector<std::int64_t> outputs;
+  IntcodeMachine::ExecState state;
+};
+
+// Runs 'program' from the start on 'prefix' until it halts or needs more
+// input.
+SpecializedProgram SpecializeIntcode(const std::vector<std::int64_t>& program,
+                                     absl::Span<const std::int64_t> prefix);
+
+// Caches a program's specializations, so that search loops that start every
+// trial with one of a few fixed prefixes (such as puzzle 7's phase settings)
+// only run the warm-up once per prefix.
+class IntcodeSpecializer {
+ public:
+  explicit IntcodeSpecializer(const std::vector<std::int64_t>& program)
+      : pristine_(IntcodeMachine(program).Snapshot()) {}
+
+  IntcodeSpecializer(const IntcodeSpecializer&) = delete;
+  IntcodeSpecializer& operator=(const IntcodeSpecializer&) = delete;
+
+  // Returns the program specialized to 'prefix', computing it on first use.
+  SpecializedProgram Specialize(absl::Span<const std::int64_t> prefix);
+
+ private:
+  const std::shared_ptr<const IntcodeMachine> pristine_;
+  absl::flat_hash_map<std::vector<std::int64_t>, SpecializedProgram> cache_;
+};
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_INTCODE_SPECIALIZE_H_
@@ -0,0 +1,109 @@
+// Checks that IntcodeSpecializer reuses the program it specialized to each
+// prefix, and that continuing a specialized program gives the same outputs
+// as running the original on the prefix followed by the rest of the input.
+
+#include <cstdint>
+#include <vector>
+
+#include "cc/util/check.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_specialize.h"
+
+namespace aoc2019 {
+namespace {
+
+// Reads a starting value, then repeatedly reads x, adds it to the total and
+// outputs the total, halting once the total reaches 1000.
+const std::vector<std::int64_t> kAccumulator = {
+    3, 100,                 // total = input
+    3, 101,                 // x = input
+    1, 100, 101, 100,       // total += x
+    4, 100,                 // output total
+    1007, 100, 1000, 102,   // below = total < 1000
+    1005, 102, 2,           // if below goto 2
+    99};
+
+// Checks that forking 'specialized' and feeding it 'rest' gives the same
+// outputs and final state as running 'program' from the start on 'prefix'
+// followed by 'rest'.
+void CheckContinuesLikeFreshRun(const std::vector<std::int64_t>& program,
+                                const SpecializedProgram& specialized,
+                                const std::vector<std::int64_t>& prefix,
+                                const std::vector<std::int64_t>& rest) {
+  IntcodeMachine fresh(program);
+  fresh.PushInputs(prefix);
+  fresh.PushInputs(rest);
+  std::vector<std::int64_t> expected_outputs;
+  const IntcodeMachine::ExecState expected_state = fresh.Run(&expected_outputs);
+
+  IntcodeMachine continued = specialized.machine->Fork();
+  continued.PushInputs(rest);
+  std::vector<std::int64_t> outputs = specialized.outputs;
+  CHECK(continued.Run(&outputs) == expected_state);
+  CHECK(outputs == expected_outputs);
+}
+
+void TestMatchesFreshRun() {
+  const std::vector<std::vector<std::int64_t>> prefixes = {
+      {}, {5}, {5, 7}, {5, 7, -3}, {5, 2000}, {999, 1, 1}};
+  const std::vector<std::vector<std::int64_t>> rests = {
+      {}, {1}, {10, 20, 30}, {-50, 400, 800}, {1000}};
+  IntcodeSpecializer specializer(kAccumulator);
+  for (const std::vector<std::int64_t>& prefix : prefixes) {
+    const SpecializedProgram specialized = specializer.Specialize(prefix);
+    const SpecializedProgram uncached = SpecializeIntcode(kAccumulator, prefix);
+    CHECK(specialized.state == uncached.state);
+    CHECK(specialized.outputs == uncached.outputs);
+    for (const std::vector<std::int64_t>& rest : rests) {
+      CheckContinuesLikeFreshRun(kAccumulator, specialized, prefix, rest);
+    }
+  }
+  CHECK(specializer.Specialize({}).state ==
+        IntcodeMachine::ExecState::kPendingInput);
+  CHECK(specializer.Specialize({5, 7}).outputs ==
+        std::vector<std::int64_t>({12}));
+  CHECK(specializer.Specialize({5, 2000}).state ==
+        IntcodeMachine::ExecState::kHalt);
+
+  // A prefix the program halts within.
+  const std::vector<std::int64_t> sieve =
+      ReadIntcodeProgram("cc/util/testdata/self_modifying_sieve.txt");
+  IntcodeSpecializer sieve_specializer(sieve);
+  const SpecializedProgram primes = sieve_specializer.Specialize({100});
+  CHECK(primes.state == IntcodeMachine::ExecState::kHalt);
+  // The 25 primes below 100, then their count.
+  CHECK(primes.outputs.size() == 26);
+  CHECK(primes.outputs.back() == 25);
+  CheckContinuesLikeFreshRun(sieve, primes, {100}, {});
+}
+
+void TestReusesSpecializations() {
+  IntcodeSpecializer specializer(kAccumulator);
+  const SpecializedProgram first = specializer.Specialize({5, 7});
+  // Running forks of it leaves the cached machine as it was.
+  for (int i = 0; i < 3; ++i) {
+    CheckContinuesLikeFreshRun(kAccumulator, first, {5, 7}, {100, 900});
+  }
+  const SpecializedProgram again = specializer.Specialize({5, 7});
+  CHECK(again.machine == first.machine);
+  CHECK(again.outputs == first.outputs);
+  CHECK(again.state == first.state);
+
+  // Other prefixes, including extensions of this one, get their own.
+  const SpecializedProgram longer = specializer.Specialize({5, 7, 1});
+  const SpecializedProgram other = specializer.Specialize({6, 7});
+  CHECK(longer.machine != first.machine);
+  CHECK(other.machine != first.machine);
+  CHECK(specializer.Specialize({5, 7, 1}).machine == longer.machine);
+  CHECK(specializer.Specialize({6, 7}).machine == other.machine);
+  CHECK(specializer.Specialize({5, 7}).machine == first.machine);
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  aoc2019::TestMatchesFreshRun();
+  aoc2019::TestReusesSpecializations();
+  return 0;
+}
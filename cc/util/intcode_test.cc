@@ -0,0 +1,385 @@
+// Differential test: runs randomly generated programs, which branch, loop,
+// move the relative base and overwrite their own code, through a simple
+// reference interpreter and through IntcodeMachine in each of the ways it can
+// run a program, and checks that they all produce the same outputs.
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "absl/numeric/int128.h"
+#include "cc/util/check.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_jit.h"
+#include "cc/util/intcode_opcodes.h"
+
+namespace aoc2019 {
+namespace {
+
+constexpr int kNumPrograms = 400;
+constexpr int kNumInputs = 200;
+constexpr int kDataWords = 64;
+
+// How a generated operand's value is chosen once the program is laid out.
+enum class OperandKind {
+  kValue,  // 'value' itself.
+  kData,   // Address 'value' of the data region after the code.
+  kPatch,  // The address of an immediate operand somewhere in the code.
+  kCode,   // Any address in the code.
+  kBlock   // The first instruction of block 'value'.
+};
+
+struct Operand {
+  int mode;
+  OperandKind kind;
+  std::int64_t value;
+};
+
+struct Instruction {
+  int op;
+  std::vector<Operand> operands;
+};
+
+// Returns a random program made of blocks of arithmetic, comparisons, outputs
+// and relative base adjustments. Most blocks start by reading input, and
+// jumps only go forward or to such blocks, so every loop eventually runs out
+// of input. Some instructions store into other instructions' operands, or
+// anywhere in the code.
+std::vector<std::int64_t> RandomProgram(std::mt19937_64& rng) {
+  const auto uniform = [&rng](std::int64_t low, std::int64_t high) {
+    return std::uniform_int_distribution<std::int64_t>(low, high)(rng);
+  };
+  const auto chance = [&rng](double p) {
+    return std::uniform_real_distribution<double>(0, 1)(rng) < p;
+  };
+  const auto read_operand = [&]() -> Operand {
+    if (chance(0.6)) return {0, OperandKind::kData, uniform(0, kDataWords - 1)};
+    return {2, OperandKind::kValue, uniform(-4, 4)};
+  };
+  const auto write_operand = [&]() -> Operand {
+    if (chance(0.6)) return {0, OperandKind::kData, uniform(0, kDataWords - 1)};
+    if (chance(0.5)) return {2, OperandKind::kValue, uniform(-4, 4)};
+    if (chance(0.5)) return {0, OperandKind::kPatch, 0};
+    if (chance(0.8)) return {0, OperandKind::kValue, uniform(1000, 70000)};
+    return {0, OperandKind::kCode, 0};
+  };
+
+  const int num_blocks = uniform(3, 14);
+  std::vector<bool> reads_input(num_blocks);
+  for (int block = 0; block < num_blocks; ++block) {
+    reads_input[block] = block == 0 || chance(0.6);
+  }
+  std::vector<Instruction> code;
+  std::vector<std::size_t> block_starts;
+  // Point the relative base into the data region.
+  code.push_back({9, {{1, OperandKind::kData, kDataWords / 2}}});
+  for (int block = 0; block < num_blocks; ++block) {
+    block_starts.push_back(code.size());
+    if (reads_input[block]) code.push_back({3, {write_operand()}});
+    for (int i = uniform(1, 6); i > 0; --i) {
+      switch (uniform(0, 5)) {
+        case 0:
+          code.push_back({9, {{1, OperandKind::kValue, uniform(-3, 3)}}});
+          break;
+        case 1:
+          code.push_back({4,
+                          {chance(0.3) ? Operand{1, OperandKind::kValue,
+                                                 uniform(-9, 9)}
+                                       : read_operand()}});
+          break;
+        default: {
+          const int ops[] = {1, 1, 2, 7, 8};
+          Instruction insn = {ops[uniform(0, 4)], {}};
+          for (int param = 0; param < 2; ++param) {
+            insn.operands.push_back(
+                chance(0.4) ? Operand{1, OperandKind::kValue, uniform(-20, 20)}
+                            : read_operand());
+          }
+          insn.operands.push_back(write_operand());
+          code.push_back(insn);
+        }
+      }
+    }
+    if (block == num_blocks - 1) {
+      code.push_back({99, {}});
+    } else if (chance(0.7)) {
+      std::vector<int> targets;
+      for (int target = 0; target < num_blocks; ++target) {
+        if (target > block || reads_input[target]) targets.push_back(target);
+      }
+      const int target = targets[uniform(0, targets.size() - 1)];
+      const Operand condition =
+          chance(0.3) ? Operand{1, OperandKind::kValue, uniform(0, 1)}
+                      : read_operand();
+      code.push_back({static_cast<int>(uniform(5, 6)),
+                      {condition, {1, OperandKind::kBlock, target}}});
+    }
+  }
+
+  std::vector<std::int64_t> pcs;
+  std::int64_t code_size = 0;
+  std::vector<std::int64_t> patchable;
+  for (const Instruction& insn : code) {
+    pcs.push_back(code_size);
+    for (std::size_t param = 0; param < insn.operands.size(); ++param) {
+      if (insn.operands[param].mode == 1) {
+        patchable.push_back(code_size + 1 + param);
+      }
+    }
+    code_size += 1 + insn.operands.size();
+  }
+  std::vector<std::int64_t> program;
+  for (const Instruction& insn : code) {
+    std::int64_t word = insn.op;
+    std::vector<std::int64_t> params;
+    for (std::size_t param = 0; param < insn.operands.size(); ++param) {
+      const Operand& operand = insn.operands[param];
+      word += operand.mode * kModeDivisors[param];
+      switch (operand.kind) {
+        case OperandKind::kValue:
+          params.push_back(operand.value);
+          break;
+        case OperandKind::kData:
+          params.push_back(code_size + operand.value);
+          break;
+        case OperandKind::kPatch:
+          params.push_back(patchable.empty()
+                               ? code_size
+                               : patchable[uniform(0, patchable.size() - 1)]);
+          break;
+        case OperandKind::kCode:
+          params.push_back(uniform(0, code_size - 1));
+          break;
+        case OperandKind::kBlock:
+          params.push_back(pcs[block_starts[operand.value]]);
+          break;
+      }
+    }
+    program.push_back(word);
+    program.insert(program.end(), params.begin(), params.end());
+  }
+  for (int i = 0; i < kDataWords; ++i) program.push_back(uniform(-10, 10));
+  return program;
+}
+
+struct RunOutcome {
+  std::vector<std::int64_t> outputs;
+  // False if the program ran out of input instead.
+  bool halted = false;
+
+  bool operator==(const RunOutcome& other) const {
+    return outputs == other.outputs && halted == other.halted;
+  }
+};
+
+// Runs 'program' on 'inputs' one instruction at a time, as simply as
+// possible. Returns nullopt for runs that IntcodeMachine would abort (an
+// illegal instruction, a negative address or signed overflow), that touch
+// very high addresses, or that take too long.
+std::optional<RunOutcome> ReferenceRun(std::vector<std::int64_t> memory,
+                                       const std::vector<std::int64_t>& inputs) {
+  constexpr int kMaxSteps = 100000;
+  constexpr std::int64_t kMaxAddress = std::int64_t{1} << 24;
+  RunOutcome outcome;
+  std::size_t next_input = 0;
+  std::int64_t pc = 0;
+  std::int64_t relative_base = 0;
+  // Every address is checked to be non-negative before it gets here.
+  const auto load = [&memory](std::int64_t address) {
+    return static_cast<std::size_t>(address) < memory.size() ? memory[address]
+                                                            : 0;
+  };
+  for (int step = 0; step < kMaxSteps; ++step) {
+    const std::int64_t instruction = load(pc);
+    if (instruction < 0 || instruction >= 100000) return std::nullopt;
+    const std::int64_t op = instruction % 100;
+    const int num_params = ParamCount(op);
+    if (num_params < 0) return std::nullopt;
+    std::int64_t addresses[3];
+    std::int64_t values[3];
+    for (int param = 0; param < num_params; ++param) {
+      const std::int64_t mode = instruction / kModeDivisors[param] % 10;
+      const std::int64_t word = load(pc + 1 + param);
+      if (mode == 1) {
+        if (param == StoreParam(op)) return std::nullopt;
+        values[param] = word;
+        continue;
+      }
+      if (mode == 0) {
+        addresses[param] = word;
+      } else if (mode != 2 || __builtin_add_overflow(relative_base, word,
+                                                      &addresses[param])) {
+        return std::nullopt;
+      }
+      if (addresses[param] < 0 || addresses[param] >= kMaxAddress) {
+        return std::nullopt;
+      }
+      values[param] = load(addresses[param]);
+    }
+    const auto store = [&](int param, std::int64_t value) {
+      if (static_cast<std::size_t>(addresses[param]) >= memory.size()) {
+        memory.resize(addresses[param] + 1, 0);
+      }
+      memory[addresses[param]] = value;
+    };
+    std::int64_t next_pc = pc + 1 + num_params;
+    std::int64_t result;
+    switch (op) {
+      case 1:
+        if (__builtin_add_overflow(values[0], values[1], &result)) {
+          return std::nullopt;
+        }
+        store(2, result);
+        break;
+      case 2:
+        if (__builtin_mul_overflow(values[0], values[1], &result)) {
+          return std::nullopt;
+        }
+        store(2, result);
+        break;
+      case 3:
+        if (next_input == inputs.size()) return outcome;
+        store(0, inputs[next_input++]);
+        break;
+      case 4:
+        outcome.outputs.push_back(values[0]);
+        break;
+      case 5:
+        if (values[0] != 0) next_pc = values[1];
+        break;
+      case 6:
+        if (values[0] == 0) next_pc = values[1];
+        break;
+      case 7:
+        store(2, values[0] < values[1] ? 1 : 0);
+        break;
+      case 8:
+        store(2, values[0] == values[1] ? 1 : 0);
+        break;
+      case 9:
+        if (__builtin_add_overflow(relative_base, values[0], &relative_base)) {
+          return std::nullopt;
+        }
+        break;
+      case 99:
+        outcome.halted = true;
+        return outcome;
+    }
+    if (next_pc < 0) return std::nullopt;
+    pc = next_pc;
+  }
+  return std::nullopt;
+}
+
+// Runs 'machine' until it halts or needs more than 'inputs', pushing each
+// input only once the machine asks for it. If 'slice' is nonzero, runs at
+// most that many instructions at a time.
+template <typename Word>
+RunOutcome RunMachine(BasicIntcodeMachine<Word>* machine,
+                      const std::vector<std::int64_t>& inputs,
+                      std::uint64_t slice = 0) {
+  using ExecState = typename BasicIntcodeMachine<Word>::ExecState;
+  RunOutcome outcome;
+  std::size_t next_input = 0;
+  std::vector<Word> outputs;
+  for (;;) {
+    outputs.clear();
+    const ExecState state = slice == 0 ? machine->Run(&outputs)
+                                       : machine->RunFor(slice, &outputs);
+    for (const Word output : outputs) {
+      outcome.outputs.push_back(static_cast<std::int64_t>(output));
+    }
+    if (state == ExecState::kHalt) {
+      outcome.halted = true;
+      return outcome;
+    }
+    if (state == ExecState::kPendingInput) {
+      if (next_input == inputs.size()) return outcome;
+      const Word input = inputs[next_input++];
+      machine->PushInputs({input});
+    }
+  }
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  using aoc2019::IntcodeMachine;
+  // Reset from every program in turn, so that it reuses pages and buffers
+  // left over from different ones.
+  IntcodeMachine reused(std::vector<std::int64_t>{99});
+  int num_checked = 0;
+  std::uint64_t num_compiled = 0;
+  for (int seed = 0; seed < aoc2019::kNumPrograms; ++seed) {
+    std::mt19937_64 rng(seed);
+    const std::vector<std::int64_t> program = aoc2019::RandomProgram(rng);
+    std::vector<std::int64_t> inputs;
+    for (int i = 0; i < aoc2019::kNumInputs; ++i) {
+      inputs.push_back(std::uniform_int_distribution<int>(-3, 3)(rng));
+    }
+    const std::optional<aoc2019::RunOutcome> expected =
+        aoc2019::ReferenceRun(program, inputs);
+    if (!expected.has_value()) continue;
+    ++num_checked;
+
+    IntcodeMachine interpreted(program);
+    CHECK(aoc2019::RunMachine(&interpreted, inputs) == *expected);
+
+    IntcodeMachine budgeted(program);
+    CHECK(aoc2019::RunMachine(&budgeted, inputs, /*slice=*/7) == *expected);
+
+    // Programs only run each block a handful of times, so compile every
+    // block the first time it's jumped to.
+    IntcodeMachine compiled(program);
+    if (compiled.EnableJit(/*hot_threshold=*/1)) {
+      CHECK(aoc2019::RunMachine(&compiled, inputs) == *expected);
+      IntcodeMachine compiled_budgeted(program);
+      CHECK(compiled_budgeted.EnableJit(/*hot_threshold=*/1));
+      CHECK(aoc2019::RunMachine(&compiled_budgeted, inputs, /*slice=*/7) ==
+            *expected);
+      num_compiled += compiled.jit()->num_executed() +
+                      compiled_budgeted.jit()->num_executed();
+    }
+
+    const IntcodeMachine loaded(program);
+    IntcodeMachine fork = loaded.Fork();
+    CHECK(aoc2019::RunMachine(&fork, inputs) == *expected);
+    reused.Reset(loaded);
+    CHECK(aoc2019::RunMachine(&reused, inputs) == *expected);
+
+    const std::vector<absl::int128> wide_program(program.begin(),
+                                                 program.end());
+    aoc2019::BasicIntcodeMachine<absl::int128> wide(wide_program);
+    CHECK(aoc2019::RunMachine(&wide, inputs) == *expected);
+
+    // Forks of a machine that has already run share its instruction cache,
+    // so check that neither decoding nor overwriting code in one of them
+    // leaks into the others.
+    const std::vector<std::int64_t> first_half(
+        inputs.begin(), inputs.begin() + inputs.size() / 2);
+    const std::vector<std::int64_t> second_half(
+        inputs.begin() + inputs.size() / 2, inputs.end());
+    IntcodeMachine warm(program);
+    const aoc2019::RunOutcome started =
+        aoc2019::RunMachine(&warm, first_half);
+    if (started.halted) continue;
+    IntcodeMachine forks[] = {warm.Fork(), warm.Fork()};
+    for (IntcodeMachine* machine : {&forks[0], &forks[1], &warm}) {
+      aoc2019::RunOutcome resumed =
+          aoc2019::RunMachine(machine, second_half);
+      resumed.outputs.insert(resumed.outputs.begin(), started.outputs.begin(),
+                             started.outputs.end());
+      CHECK(resumed == *expected);
+    }
+  }
+  // Most programs should be runnable.
+  CHECK(num_checked > aoc2019::kNumPrograms / 2);
+  if (aoc2019::IntcodeJit::IsSupported()) {
+    // Compiled code should have run a fair share of the instructions.
+    CHECK(num_compiled > aoc2019::kNumPrograms);
+  }
+  return 0;
+}
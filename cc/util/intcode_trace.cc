@@ -0,0 +1,53 @@
+#include "cc/util/intcode_trace.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <vector>
+
+#include "absl/types/span.h"
+
+namespace aoc2019 {
+
+IntcodeTrace::IntcodeTrace(std::size_t capacity) {
+  std::size_t size = 1;
+  while (size < capacity) size *= 2;
+  ring_.resize(size);
+  mask_ = size - 1;
+}
+
+std::vector<IntcodeTrace::Entry> IntcodeTrace::entries() const {
+  const std::uint64_t count = std::min<std::uint64_t>(next_, ring_.size());
+  std::vector<Entry> entries;
+  entries.reserve(count);
+  for (std::uint64_t index = next_ - count; index < next_; ++index) {
+    entries.push_back(ring_[index & mask_]);
+  }
+  return entries;
+}
+
+bool WriteIntcodeInputLog(const char* filename,
+                          absl::Span<const std::int64_t> inputs) {
+  std::ofstream stream(filename, std::ios::binary);
+  stream.write(reinterpret_cast<const char*>(inputs.data()),
+               inputs.size() * sizeof(std::int64_t));
+  return static_cast<bool>(stream);
+}
+
+std::optional<std::vector<std::int64_t>> ReadIntcodeInputLog(
+    const char* filename) {
+  std::ifstream stream(filename, std::ios::binary);
+  if (!stream) return std::nullopt;
+  stream.seekg(0, std::ios::end);
+  const std::streamoff size = stream.tellg();
+  if (size < 0 || size % sizeof(std::int64_t) != 0) return std::nullopt;
+  std::vector<std::int64_t> inputs(size / sizeof(std::int64_t));
+  stream.seekg(0, std::ios::beg);
+  stream.read(reinterpret_cast<char*>(inputs.data()), size);
+  if (!stream) return std::nullopt;
+  return inputs;
+}
+
+}  // namespace aoc2019
@@ -0,0 +1,75 @@
+#ifndef CC_UTIL_INTCODE_TRACE_H_
+#define CC_UTIL_INTCODE_TRACE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "absl/types/span.h"
+
+namespace aoc2019 {
+
+// A record of what an Intcode machine has been doing: the most recent
+// instructions it executed, in a fixed-size ring that overwrites the oldest
+// entry once full, and every input it has consumed since tracing started.
+// Feeding the input log to a fresh copy of the program (see ReplayIntcode())
+// reproduces the run exactly.
+class IntcodeTrace {
+ public:
+  struct Entry {
+    std::uint64_t pc;
+    std::int64_t instruction;
+    std::int64_t relative_base;
+    // The value read for each input parameter, or the address written for
+    // the output parameter. Reads from negative addresses are recorded as 0.
+    std::int64_t operands[3];
+  };
+
+  // Keeps the last 'capacity' instructions, rounded up to a power of two.
+  explicit IntcodeTrace(std::size_t capacity);
+
+  void Record(const Entry& entry) {
+    Entry& slot = ring_[next_++ & mask_];
+    overwritten_ = slot;
+    slot = entry;
+  }
+
+  // Removes the entry most recently recorded, for an instruction that turned
+  // out not to run, and puts back the one it overwrote. Only one entry can be
+  // dropped between calls to Record().
+  void DropLast() { ring_[--next_ & mask_] = overwritten_; }
+
+  void LogInput(std::int64_t value) { inputs_.push_back(value); }
+
+  // Returns the instructions in the ring, oldest first.
+  std::vector<Entry> entries() const;
+
+  // Returns the number of instructions recorded, including ones that have
+  // since been overwritten.
+  std::uint64_t num_recorded() const { return next_; }
+
+  const std::vector<std::int64_t>& input_log() const { return inputs_; }
+
+ private:
+  std::vector<Entry> ring_;
+  std::uint64_t mask_;
+  std::uint64_t next_ = 0;
+  // The entry that the last call to Record() replaced.
+  Entry overwritten_ = {};
+  std::vector<std::int64_t> inputs_;
+};
+
+// Writes 'inputs' to 'filename' as raw native-endian 64-bit words. Returns
+// false if the file can't be written.
+bool WriteIntcodeInputLog(const char* filename,
+                          absl::Span<const std::int64_t> inputs);
+
+// Reads a log written by WriteIntcodeInputLog(), or returns nullopt if the
+// file can't be read.
+std::optional<std::vector<std::int64_t>> ReadIntcodeInputLog(
+    const char* filename);
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_INTCODE_TRACE_H_
@@ -0,0 +1,71 @@
+// Checks that IntcodeTrace keeps exactly the instructions that ran when a
+// machine stalls on input after its ring has wrapped around.
+
+#include <cstdint>
+#include <vector>
+
+#include "cc/util/check.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_trace.h"
+
+namespace aoc2019 {
+namespace {
+
+// Reads a word, counts [24] up to 5 in a loop at pc 6, then reads two more
+// words and halts.
+std::vector<std::int64_t> CountingProgram() {
+  std::vector<std::int64_t> program = {3,    30, 1101, 0,  0,  24, 1001, 24,
+                                       1,    24, 1007, 24, 5,  25, 1005, 25,
+                                       6,    3,  26,   3,  27, 99};
+  program.resize(31, 0);
+  return program;
+}
+
+// Returns the pc of every entry in the trace, oldest first.
+std::vector<std::uint64_t> TracedPcs(const IntcodeTrace& trace) {
+  std::vector<std::uint64_t> pcs;
+  for (const IntcodeTrace::Entry& entry : trace.entries()) {
+    pcs.push_back(entry.pc);
+  }
+  return pcs;
+}
+
+void TestStallAfterWrapping() {
+  IntcodeMachine machine(CountingProgram());
+  machine.EnableTrace(8);
+  machine.PushInputs({7});
+  CHECK(machine.Run().state == IntcodeMachine::ExecState::kPendingInput);
+  // 17 instructions ran: the first input, the store at pc 2 and five passes
+  // through the loop. The stalled input at pc 17 must not be among them.
+  const IntcodeTrace& trace = *machine.trace();
+  CHECK(trace.num_recorded() == 17);
+  CHECK(TracedPcs(trace) ==
+        std::vector<std::uint64_t>({10, 14, 6, 10, 14, 6, 10, 14}));
+  CHECK(trace.entries().front().instruction == 1007);
+
+  machine.PushInputs({1, 2});
+  CHECK(machine.Run().state == IntcodeMachine::ExecState::kHalt);
+  CHECK(trace.num_recorded() == 20);
+  CHECK(TracedPcs(trace) ==
+        std::vector<std::uint64_t>({10, 14, 6, 10, 14, 17, 19, 21}));
+  CHECK(trace.input_log() == std::vector<std::int64_t>({7, 1, 2}));
+}
+
+void TestRepeatedStalls() {
+  // Stalling twice in a row at the same pc drops both attempts.
+  IntcodeMachine machine(CountingProgram());
+  machine.EnableTrace(4);
+  CHECK(machine.Run().state == IntcodeMachine::ExecState::kPendingInput);
+  CHECK(machine.Run().state == IntcodeMachine::ExecState::kPendingInput);
+  CHECK(machine.trace()->num_recorded() == 0);
+  CHECK(machine.trace()->entries().empty());
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  aoc2019::TestStallAfterWrapping();
+  aoc2019::TestRepeatedStalls();
+  return 0;
+}
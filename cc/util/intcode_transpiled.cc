@@ -0,0 +1,136 @@
+#include "cc/util/intcode_transpiled.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+
+#include "absl/types/span.h"
+#include "cc/util/check.h"
+#include "cc/util/intcode_opcodes.h"
+
+namespace aoc2019 {
+
+TranspiledIntcodeMachine::TranspiledIntcodeMachine(
+    const std::int64_t* program, const std::uint8_t* lengths,
+    std::size_t size)
+    : memory_(absl::MakeConstSpan(program, size)),
+      program_(program),
+      lengths_(lengths),
+      size_(size),
+      covered_(size, 0),
+      stale_(size, 0) {
+  for (std::size_t pc = 0; pc < size; ++pc) {
+    std::fill_n(covered_.begin() + pc, lengths[pc], 1);
+  }
+}
+
+void TranspiledIntcodeMachine::PushInputs(
+    absl::Span<const std::int64_t> inputs) {
+  queued_inputs_.Append(inputs.begin(), inputs.end());
+}
+
+void TranspiledIntcodeMachine::PushAsciiInputs(absl::string_view text) {
+  queued_inputs_.Append(text.begin(), text.end());
+}
+
+void TranspiledIntcodeMachine::Invalidate(
+    std::vector<std::int64_t>::size_type position) {
+  // Instructions are at most 4 words long.
+  const std::vector<std::int64_t>::size_type first =
+      position < 3 ? 0 : position - 3;
+  for (std::vector<std::int64_t>::size_type pc = first; pc <= position; ++pc) {
+    if (pc + lengths_[pc] > position) stale_[pc] = 1;
+  }
+}
+
+std::int64_t TranspiledIntcodeMachine::ParamAddress(std::int64_t instruction,
+                                                    int param) {
+  const std::int64_t value = Load(pc_ + 1 + param);
+  switch (instruction / kModeDivisors[param] % 10) {
+    case 0:
+      return value;
+    case 2:
+      return relative_base_ + value;
+    default:
+      std::cerr << "Invalid addressing mode: "
+                << instruction / kModeDivisors[param] % 10 << "\n";
+      CHECK(false);
+  }
+}
+
+TranspiledIntcodeMachine::StepResult TranspiledIntcodeMachine::Step(
+    std::deque<std::int64_t>* outputs) {
+  const std::int64_t instruction = Load(pc_);
+  const auto load = [&](int param) {
+    return instruction / kModeDivisors[param] % 10 == 1
+               ? Load(pc_ + 1 + param)
+               : Load(ParamAddress(instruction, param));
+  };
+  const auto store_address = [&](int param) {
+    if (instruction / kModeDivisors[param] % 10 == 1) {
+      std::cerr << "Can't store with immediate mode destination\n";
+      CHECK(false);
+    }
+    return ParamAddress(instruction, param);
+  };
+
+  switch (instruction % 100) {
+    case 1:
+    case 2:
+    case 7:
+    case 8: {
+      const std::int64_t param0 = load(0);
+      const std::int64_t param1 = load(1);
+      const std::int64_t address = store_address(2);
+      std::int64_t result;
+      switch (instruction % 100) {
+        case 1:
+          result = param0 + param1;
+          break;
+        case 2:
+          result = param0 * param1;
+          break;
+        case 7:
+          result = param0 < param1;
+          break;
+        default:
+          result = param0 == param1;
+          break;
+      }
+      pc_ += 4;
+      Store(address, result);
+      return StepResult::kContinue;
+    }
+    case 3: {
+      if (queued_inputs_.empty()) return StepResult::kPendingInput;
+      const std::int64_t address = store_address(0);
+      const std::int64_t value = queued_inputs_.front();
+      queued_inputs_.pop_front();
+      pc_ += 2;
+      Store(address, value);
+      return StepResult::kContinue;
+    }
+    case 4:
+      outputs->push_back(load(0));
+      pc_ += 2;
+      return StepResult::kContinue;
+    case 5:
+    case 6: {
+      const bool taken = (load(0) != 0) == (instruction % 100 == 5);
+      pc_ = taken ? load(1) : pc_ + 3;
+      return StepResult::kContinue;
+    }
+    case 9:
+      relative_base_ += load(0);
+      pc_ += 2;
+      return StepResult::kContinue;
+    case 99:
+      return StepResult::kHalt;
+    default:
+      std::cerr << "Unrecognized opcode: " << instruction << "\n";
+      CHECK(false);
+  }
+}
+
+}  // namespace aoc2019
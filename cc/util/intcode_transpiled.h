@@ -0,0 +1,94 @@
+#ifndef CC_UTIL_INTCODE_TRANSPILED_H_
+#define CC_UTIL_INTCODE_TRANSPILED_H_
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_memory.h"
+#include "cc/util/ring_buffer.h"
+
+namespace aoc2019 {
+
+// Runtime support for Intcode programs compiled to C++ by
+// //cc/util:intcode_transpiler (see intcode_cc_library() in intcode.bzl).
+//
+// Generated classes derive from this and implement Run() as straight C++ code
+// with one label per instruction. Whenever the generated code can't handle the
+// next instruction (a computed jump to an address that wasn't compiled, or an
+// instruction that the program has overwritten), it falls back to Step(),
+// which interprets a single instruction.
+class TranspiledIntcodeMachine {
+ public:
+  using ExecState = IntcodeMachine::ExecState;
+  using RunResult = IntcodeMachine::RunResult;
+
+  void PushInputs(absl::Span<const std::int64_t> inputs);
+
+  template <typename It>
+  void PushInputs(It begin, It end) {
+    queued_inputs_.Append(begin, end);
+  }
+
+  void PushAsciiInputs(absl::string_view text);
+
+ protected:
+  enum class StepResult {
+    kContinue,
+    kPendingInput,
+    kHalt
+  };
+
+  // 'lengths' holds, for every word of 'program', the length of the
+  // instruction starting there that the generated code was compiled from, or
+  // 0 if there is none. Both arrays must have 'size' elements and outlive the
+  // machine.
+  TranspiledIntcodeMachine(const std::int64_t* program,
+                           const std::uint8_t* lengths, std::size_t size);
+
+  std::int64_t Load(std::int64_t position) const {
+    return memory_.Load(position);
+  }
+
+  void Store(std::int64_t position, std::int64_t value) {
+    const std::uint64_t index = position;
+    memory_.Store(index, value);
+    if (index < size_ && covered_[index] != 0 && program_[index] != value) {
+      Invalidate(index);
+    }
+  }
+
+  // Returns true if the compiled instruction at 'pc' can't be used anymore,
+  // because the program has overwritten it.
+  bool stale(std::int64_t pc) const { return stale_[pc] != 0; }
+
+  // Interprets the instruction at pc_.
+  StepResult Step(std::deque<std::int64_t>* outputs);
+
+  IntcodeMemory memory_;
+  std::int64_t pc_ = 0;
+  std::int64_t relative_base_ = 0;
+  RingBuffer<std::int64_t> queued_inputs_;
+
+ private:
+  // Returns the address referred to by absolute or relative mode parameter
+  // 'param' of the instruction at pc_.
+  std::int64_t ParamAddress(std::int64_t instruction, int param);
+
+  // Marks every compiled instruction covering 'position' stale.
+  void Invalidate(std::vector<std::int64_t>::size_type position);
+
+  const std::int64_t* program_;
+  const std::uint8_t* lengths_;
+  std::size_t size_;
+  // Nonzero for every word covered by a compiled instruction.
+  std::vector<std::uint8_t> covered_;
+  std::vector<std::uint8_t> stale_;
+};
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_INTCODE_TRANSPILED_H_
@@ -0,0 +1,363 @@
+// Compiles an Intcode program to a C++ class deriving from
+// TranspiledIntcodeMachine. Usually run through intcode_cc_library() in
+// intcode.bzl rather than directly.
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_replace.h"
+#include "absl/strings/substitute.h"
+#include "cc/util/check.h"
+#include "cc/util/intcode.h"
+#include "cc/util/intcode_opcodes.h"
+
+namespace aoc2019 {
+namespace {
+
+struct Instruction {
+  std::int64_t pc;
+  std::int64_t op;
+  int length;
+  std::int64_t modes[3];
+  std::int64_t params[3];
+};
+
+// Decodes the instruction at 'pc'. Returns false if it isn't a valid
+// instruction lying entirely within 'program'.
+bool DecodeInstruction(const std::vector<std::int64_t>& program,
+                       std::int64_t pc, Instruction* insn) {
+  const std::int64_t size = program.size();
+  if (pc < 0 || pc >= size || program[pc] < 0) return false;
+  insn->pc = pc;
+  insn->op = program[pc] % 100;
+  const int num_params = ParamCount(insn->op);
+  if (num_params < 0) return false;
+  const int store_param = StoreParam(insn->op);
+  insn->length = num_params + 1;
+  if (pc + insn->length > size) return false;
+  for (int param = 0; param < num_params; ++param) {
+    insn->modes[param] = program[pc] / kModeDivisors[param] % 10;
+    if (insn->modes[param] > 2) return false;
+    if (param == store_param && insn->modes[param] == 1) return false;
+    insn->params[param] = program[pc + 1 + param];
+  }
+  return true;
+}
+
+// Returns a C++ expression for 'value'. The most negative value isn't a valid
+// literal on its own.
+std::string Literal(std::int64_t value) {
+  if (value == std::numeric_limits<std::int64_t>::min()) {
+    return absl::StrCat("(", value + 1, " - 1)");
+  }
+  return absl::StrCat(value);
+}
+
+// Returns true if 'insn' can continue to the instruction after it.
+bool FallsThrough(const Instruction& insn) {
+  if (insn.op == 99) return false;
+  if ((insn.op == 5 || insn.op == 6) && insn.modes[0] == 1) {
+    return (insn.params[0] != 0) != (insn.op == 5);
+  }
+  return true;
+}
+
+// Returns true if 'pc' directly follows an unconditional jump.
+bool FollowsUnconditionalJump(const std::vector<std::int64_t>& program,
+                              std::int64_t pc) {
+  Instruction jump;
+  return DecodeInstruction(program, pc - 3, &jump) &&
+         (jump.op == 5 || jump.op == 6) && !FallsThrough(jump);
+}
+
+// Finds the instructions to compile: everything reachable from pc 0 by
+// falling through or by static jumps. Computed jumps are usually returns from
+// a call, i.e. jumps to the instruction after an unconditional jump, whose
+// address was pushed as an immediate operand. Such addresses are treated as
+// entry points too. Anything else reached by a computed jump is interpreted.
+std::vector<Instruction> FindInstructions(
+    const std::vector<std::int64_t>& program) {
+  std::vector<std::int64_t> worklist = {0};
+  Instruction insn;
+  const std::int64_t size = program.size();
+  for (std::int64_t pc = 0; pc < size; ++pc) {
+    if (!DecodeInstruction(program, pc, &insn)) continue;
+    for (int param = 0; param < insn.length - 1; ++param) {
+      if (insn.modes[param] == 1 &&
+          FollowsUnconditionalJump(program, insn.params[param])) {
+        worklist.push_back(insn.params[param]);
+      }
+    }
+  }
+
+  std::set<std::int64_t> visited;
+  std::vector<Instruction> instructions;
+  while (!worklist.empty()) {
+    const std::int64_t pc = worklist.back();
+    worklist.pop_back();
+    if (!visited.insert(pc).second) continue;
+    if (!DecodeInstruction(program, pc, &insn)) continue;
+    instructions.push_back(insn);
+    if (FallsThrough(insn)) worklist.push_back(pc + insn.length);
+    if ((insn.op == 5 || insn.op == 6) && insn.modes[1] == 1) {
+      worklist.push_back(insn.params[1]);
+    }
+  }
+  std::sort(instructions.begin(), instructions.end(),
+            [](const Instruction& a, const Instruction& b) {
+              return a.pc < b.pc;
+            });
+  return instructions;
+}
+
+class Transpiler {
+ public:
+  Transpiler(const std::vector<std::int64_t>& program,
+             std::vector<Instruction> instructions)
+      : program_(program), instructions_(std::move(instructions)) {
+    for (const Instruction& insn : instructions_) {
+      compiled_pcs_.insert(insn.pc);
+    }
+  }
+
+  // Returns the body of Run().
+  std::string RunBody() {
+    std::string body =
+        "  std::deque<std::int64_t> outputs;\n"
+        "dispatch:\n"
+        "  switch (pc_) {\n";
+    for (const Instruction& insn : instructions_) {
+      absl::StrAppend(&body, "    case ", insn.pc, ":\n      if (!stale(",
+                      insn.pc, ")) goto pc_", insn.pc, ";\n      break;\n");
+    }
+    absl::StrAppend(
+        &body,
+        "  }\n"
+        "  switch (Step(&outputs)) {\n"
+        "    case StepResult::kContinue:\n"
+        "      goto dispatch;\n"
+        "    case StepResult::kPendingInput:\n"
+        "      return {ExecState::kPendingInput, std::move(outputs)};\n"
+        "    case StepResult::kHalt:\n"
+        "      return {ExecState::kHalt, std::move(outputs)};\n"
+        "  }\n");
+
+    for (std::size_t i = 0; i < instructions_.size(); ++i) {
+      const Instruction& insn = instructions_[i];
+      absl::StrAppend(&body, "pc_", insn.pc, ":\n",
+                      "  if (ABSL_PREDICT_FALSE(stale(", insn.pc,
+                      "))) { pc_ = ", insn.pc, "; goto dispatch; }\n");
+      EmitInstruction(insn, &body);
+      if (FallsThrough(insn)) {
+        const std::int64_t next = insn.pc + insn.length;
+        if (i + 1 == instructions_.size() ||
+            instructions_[i + 1].pc != next) {
+          absl::StrAppend(&body, "  ", Goto(next), "\n");
+        }
+      }
+    }
+    return body;
+  }
+
+  // Returns an initializer list for an array with one entry per word of the
+  // program, holding the length of the compiled instruction starting there
+  // (or 0).
+  std::string InstructionLengths() {
+    std::vector<int> lengths(program_.size(), 0);
+    for (const Instruction& insn : instructions_) {
+      lengths[insn.pc] = insn.length;
+    }
+    return absl::StrJoin(lengths, ",");
+  }
+
+ private:
+  static std::string Operand(const Instruction& insn, int param) {
+    switch (insn.modes[param]) {
+      case 0:
+        return absl::StrCat("Load(", Literal(insn.params[param]), ")");
+      case 1:
+        return absl::StrCat("std::int64_t{", Literal(insn.params[param]),
+                            "}");
+      default:
+        return absl::StrCat("Load(relative_base_ + ",
+                            Literal(insn.params[param]), ")");
+    }
+  }
+
+  static std::string Address(const Instruction& insn, int param) {
+    return insn.modes[param] == 0
+               ? Literal(insn.params[param])
+               : absl::StrCat("relative_base_ + ",
+                              Literal(insn.params[param]));
+  }
+
+  // Returns a statement that continues execution at the static address
+  // 'pc'.
+  std::string Goto(std::int64_t pc) const {
+    if (compiled_pcs_.count(pc) != 0) {
+      return absl::StrCat("goto pc_", pc, ";");
+    }
+    return absl::StrCat("{ pc_ = ", pc, "; goto dispatch; }");
+  }
+
+  void EmitInstruction(const Instruction& insn, std::string* body) {
+    switch (insn.op) {
+      case 1:
+      case 2:
+      case 7:
+      case 8: {
+        const char* const op = insn.op == 1   ? "+"
+                               : insn.op == 2 ? "*"
+                               : insn.op == 7 ? "<"
+                                              : "==";
+        absl::StrAppend(body, "  Store(", Address(insn, 2), ", ",
+                        Operand(insn, 0), " ", op, " ", Operand(insn, 1),
+                        ");\n");
+        return;
+      }
+      case 3:
+        absl::StrAppend(
+            body, "  if (queued_inputs_.empty()) {\n", "    pc_ = ", insn.pc,
+            ";\n",
+            "    return {ExecState::kPendingInput, std::move(outputs)};\n",
+            "  }\n", "  Store(", Address(insn, 0),
+            ", queued_inputs_.front());\n",
+            "  queued_inputs_.pop_front();\n");
+        return;
+      case 4:
+        absl::StrAppend(body, "  outputs.push_back(", Operand(insn, 0),
+                        ");\n");
+        return;
+      case 5:
+      case 6: {
+        std::string target;
+        if (insn.modes[1] == 1) {
+          target = Goto(insn.params[1]);
+        } else {
+          target =
+              absl::StrCat("{ pc_ = ", Operand(insn, 1), "; goto dispatch; }");
+        }
+        if (insn.modes[0] == 1) {
+          if (!FallsThrough(insn)) absl::StrAppend(body, "  ", target, "\n");
+          return;
+        }
+        absl::StrAppend(body, "  if (", Operand(insn, 0),
+                        insn.op == 5 ? " != 0) " : " == 0) ", target, "\n");
+        return;
+      }
+      case 9:
+        absl::StrAppend(body, "  relative_base_ += ", Operand(insn, 0),
+                        ";\n");
+        return;
+      case 99:
+        absl::StrAppend(body, "  pc_ = ", insn.pc, ";\n",
+                        "  return {ExecState::kHalt, std::move(outputs)};\n");
+        return;
+    }
+  }
+
+  const std::vector<std::int64_t>& program_;
+  const std::vector<Instruction> instructions_;
+  std::set<std::int64_t> compiled_pcs_;
+};
+
+constexpr char kHeaderTemplate[] = R"(// Generated by //cc/util:intcode_transpiler. Do not edit.
+
+#ifndef $0
+#define $0
+
+#include "cc/util/intcode_transpiled.h"
+
+namespace aoc2019 {
+
+class $1 : public TranspiledIntcodeMachine {
+ public:
+  $1();
+
+  RunResult Run();
+};
+
+}  // namespace aoc2019
+
+#endif  // $0
+)";
+
+constexpr char kSourceTemplate[] = R"(// Generated by //cc/util:intcode_transpiler. Do not edit.
+
+#include "$0"
+
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+#include "absl/base/optimization.h"
+
+namespace aoc2019 {
+namespace {
+
+constexpr std::int64_t kProgram[] = {$2};
+constexpr std::uint8_t kInstructionLengths[] = {$3};
+
+}  // namespace
+
+$1::$1()
+    : TranspiledIntcodeMachine(kProgram, kInstructionLengths,
+                               sizeof(kProgram) / sizeof(kProgram[0])) {}
+
+$1::RunResult $1::Run() {
+$4}
+
+}  // namespace aoc2019
+)";
+
+void WriteFile(const char* filename, const std::string& contents) {
+  std::ofstream stream(filename);
+  CHECK(stream);
+  stream << contents;
+  stream.close();
+  CHECK(stream);
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main(int argc, char** argv) {
+  if (argc != 6) {
+    std::cerr << "USAGE: intcode_transpiler PROGRAM CLASS_NAME INCLUDE_PATH "
+                 "OUT_HEADER OUT_SOURCE\n";
+    return 1;
+  }
+  const std::vector<std::int64_t> program =
+      aoc2019::ReadIntcodeProgram(argv[1]);
+  CHECK(!program.empty());
+  aoc2019::Transpiler transpiler(program,
+                                 aoc2019::FindInstructions(program));
+
+  std::string guard = absl::StrReplaceAll(
+      argv[3], {{"/", "_"}, {".", "_"}, {"-", "_"}});
+  std::transform(guard.begin(), guard.end(), guard.begin(), ::toupper);
+  absl::StrAppend(&guard, "_");
+
+  aoc2019::WriteFile(
+      argv[4], absl::Substitute(aoc2019::kHeaderTemplate, guard, argv[2]));
+  aoc2019::WriteFile(
+      argv[5],
+      absl::Substitute(aoc2019::kSourceTemplate, argv[3], argv[2],
+                       absl::StrJoin(program, ",",
+                                     [](std::string* out, std::int64_t value) {
+                                       out->append(aoc2019::Literal(value));
+                                     }),
+                       transpiler.InstructionLengths(), transpiler.RunBody()));
+  return 0;
+}
@@ -0,0 +1,51 @@
+// Checks that programs compiled by intcode_cc_library() behave exactly like
+// IntcodeMachine, including when they overwrite their own compiled code or
+// jump to computed addresses.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cc/util/check.h"
+#include "cc/util/intcode.h"
+#include "cc/util/recursive_fib_intcode.h"
+#include "cc/util/self_modifying_sieve_intcode.h"
+
+namespace aoc2019 {
+namespace {
+
+// Runs 'filename' both ways, first without input and then on each of
+// 'inputs' in turn, checking that every run stops in the same state with the
+// same outputs.
+template <typename Transpiled>
+void CheckMatchesInterpreter(const char* filename,
+                             const std::vector<std::int64_t>& inputs) {
+  IntcodeMachine interpreted(ReadIntcodeProgram(filename));
+  Transpiled transpiled;
+  for (std::size_t i = 0; i <= inputs.size(); ++i) {
+    if (i > 0) {
+      interpreted.PushInputs({inputs[i - 1]});
+      transpiled.PushInputs({inputs[i - 1]});
+    }
+    const IntcodeMachine::RunResult expected = interpreted.Run();
+    const IntcodeMachine::RunResult actual = transpiled.Run();
+    CHECK(actual.state == expected.state);
+    CHECK(actual.outputs == expected.outputs);
+    if (expected.state == IntcodeMachine::ExecState::kHalt) return;
+  }
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  for (const std::int64_t n : {0, 1, 2, 3, 100, 5000}) {
+    aoc2019::CheckMatchesInterpreter<aoc2019::SelfModifyingSieveIntcode>(
+        "cc/util/testdata/self_modifying_sieve.txt", {n});
+  }
+  for (const std::int64_t n : {0, 1, 2, 10, 20}) {
+    aoc2019::CheckMatchesInterpreter<aoc2019::RecursiveFibIntcode>(
+        "cc/util/testdata/recursive_fib.txt", {n});
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+#ifndef CC_UTIL_RING_BUFFER_H_
+#define CC_UTIL_RING_BUFFER_H_
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cc/util/check.h"
+
+namespace aoc2019 {
+
+// A FIFO queue stored in a single power-of-two sized array. Unlike std::deque,
+// popping never frees storage, so a queue whose length stays bounded stops
+// allocating once it has grown to fit.
+template <typename T>
+class RingBuffer {
+ public:
+  RingBuffer() = default;
+
+  bool empty() const { return head_ == tail_; }
+  std::size_t size() const { return tail_ - head_; }
+
+  const T& front() const {
+    CHECK(!empty());
+    return buffer_[head_ & mask()];
+  }
+
+  void push_back(T value) {
+    if (size() == buffer_.size()) Grow(size() + 1);
+    buffer_[tail_++ & mask()] = std::move(value);
+  }
+
+  void pop_front() {
+    CHECK(!empty());
+    ++head_;
+  }
+
+  // Appends every element of ['begin', 'end').
+  template <typename It>
+  void Append(It begin, It end) {
+    if constexpr (std::is_base_of_v<
+                      std::forward_iterator_tag,
+                      typename std::iterator_traits<It>::iterator_category>) {
+      const std::size_t count = std::distance(begin, end);
+      if (size() + count > buffer_.size()) Grow(size() + count);
+    }
+    for (; begin != end; ++begin) {
+      push_back(*begin);
+    }
+  }
+
+  void clear() { head_ = tail_ = 0; }
+
+  // Replaces the contents with those of 'other'. Unlike assignment, keeps
+  // this queue's storage if it is large enough.
+  void Assign(const RingBuffer& other) {
+    clear();
+    for (std::size_t i = other.head_; i != other.tail_; ++i) {
+      push_back(other.buffer_[i & other.mask()]);
+    }
+  }
+
+ private:
+  std::size_t mask() const { return buffer_.size() - 1; }
+
+  void Grow(std::size_t min_capacity) {
+    std::size_t capacity = buffer_.empty() ? 16 : buffer_.size() * 2;
+    while (capacity < min_capacity) capacity *= 2;
+    std::vector<T> grown(capacity);
+    for (std::size_t i = 0; i < size(); ++i) {
+      grown[i] = std::move(buffer_[(head_ + i) & mask()]);
+    }
+    tail_ = size();
+    head_ = 0;
+    buffer_ = std::move(grown);
+  }
+
+  std::vector<T> buffer_;
+  // Elements are buffer_[head_ & mask()] through buffer_[(tail_ - 1) & mask()].
+  // Both only ever increase, except when the buffer grows or is cleared.
+  std::size_t head_ = 0;
+  std::size_t tail_ = 0;
+};
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_RING_BUFFER_H_
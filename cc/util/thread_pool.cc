@@ -0,0 +1,151 @@
+#include "cc/util/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <thread>
+
+#include "absl/synchronization/mutex.h"
+#include "cc/util/check.h"
+
+namespace aoc2019 {
+namespace {
+
+std::uint64_t PackRange(std::uint32_t begin, std::uint32_t end) {
+  return std::uint64_t{begin} << 32 | end;
+}
+
+std::uint32_t RangeBegin(std::uint64_t range) { return range >> 32; }
+
+std::uint32_t RangeEnd(std::uint64_t range) {
+  return static_cast<std::uint32_t>(range);
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool(int num_threads)
+    : shares_(num_threads > 0
+                  ? num_threads
+                  : std::max<int>(std::thread::hardware_concurrency(), 1)) {
+  // The calling thread is worker 0.
+  for (std::size_t worker = 1; worker < shares_.size(); ++worker) {
+    threads_.emplace_back(&ThreadPool::WorkerLoop, this, worker);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    absl::MutexLock lock(&mutex_);
+    shutdown_ = true;
+  }
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+ThreadPool& ThreadPool::Default() {
+  static ThreadPool* const pool = new ThreadPool();
+  return *pool;
+}
+
+void ThreadPool::ParallelFor(std::size_t count, Fn fn) {
+  if (count == 0) return;
+  CHECK(count <= std::numeric_limits<std::uint32_t>::max());
+  absl::MutexLock call_lock(&call_mutex_);
+  const int num_workers = shares_.size();
+  for (int worker = 0; worker < num_workers; ++worker) {
+    shares_[worker].range.store(
+        PackRange(count * worker / num_workers,
+                  count * (worker + 1) / num_workers),
+        std::memory_order_relaxed);
+  }
+  if (!threads_.empty()) {
+    absl::MutexLock lock(&mutex_);
+    fn_ = &fn;
+    ++generation_;
+    busy_threads_ = threads_.size();
+  }
+
+  RunShares(0, fn);
+
+  if (!threads_.empty()) {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(absl::Condition(
+        +[](int* busy_threads) { return *busy_threads == 0; },
+        &busy_threads_));
+    fn_ = nullptr;
+  }
+}
+
+void ThreadPool::RunShares(int worker, Fn fn) {
+  do {
+    std::uint32_t index;
+    while (TakeOwn(worker, &index)) {
+      fn(worker, index);
+    }
+  } while (Steal(worker));
+}
+
+bool ThreadPool::TakeOwn(int worker, std::uint32_t* index) {
+  std::atomic<std::uint64_t>& range = shares_[worker].range;
+  std::uint64_t current = range.load(std::memory_order_acquire);
+  for (;;) {
+    const std::uint32_t begin = RangeBegin(current);
+    const std::uint32_t end = RangeEnd(current);
+    if (begin >= end) return false;
+    if (range.compare_exchange_weak(current, PackRange(begin + 1, end),
+                                    std::memory_order_acq_rel)) {
+      *index = begin;
+      return true;
+    }
+  }
+}
+
+bool ThreadPool::Steal(int worker) {
+  const int num_workers = shares_.size();
+  for (int offset = 1; offset < num_workers; ++offset) {
+    std::atomic<std::uint64_t>& victim =
+        shares_[(worker + offset) % num_workers].range;
+    std::uint64_t current = victim.load(std::memory_order_acquire);
+    for (;;) {
+      const std::uint32_t begin = RangeBegin(current);
+      const std::uint32_t end = RangeEnd(current);
+      // Leave a lone index to its owner, who is about to run it anyway.
+      if (end <= begin + 1) break;
+      const std::uint32_t middle = end - (end - begin) / 2;
+      if (victim.compare_exchange_weak(current, PackRange(begin, middle),
+                                       std::memory_order_acq_rel)) {
+        // Nobody else modifies an empty share, so a plain store is enough.
+        shares_[worker].range.store(PackRange(middle, end),
+                                    std::memory_order_release);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ThreadPool::WorkerLoop(int worker) {
+  std::uint64_t seen_generation = 0;
+  for (;;) {
+    const Fn* fn;
+    {
+      absl::MutexLock lock(&mutex_);
+      const auto ready = [this, seen_generation]() {
+        mutex_.AssertHeld();
+        return shutdown_ || generation_ != seen_generation;
+      };
+      mutex_.Await(absl::Condition(&ready));
+      if (shutdown_) return;
+      seen_generation = generation_;
+      fn = fn_;
+    }
+    RunShares(worker, *fn);
+    absl::MutexLock lock(&mutex_);
+    --busy_threads_;
+  }
+}
+
+}  // namespace aoc2019
@@ -0,0 +1,82 @@
+#ifndef CC_UTIL_THREAD_POOL_H_
+#define CC_UTIL_THREAD_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/function_ref.h"
+#include "absl/synchronization/mutex.h"
+
+namespace aoc2019 {
+
+// A fixed set of worker threads for running parallel loops. ParallelFor()
+// deals each worker an equal share of the indices; a worker that runs out
+// steals half of another worker's remaining share, so uneven jobs still keep
+// every thread busy.
+class ThreadPool {
+ public:
+  // Creates a pool of 'num_threads' workers, counting the thread that calls
+  // ParallelFor(), or one per hardware thread if 'num_threads' is 0.
+  explicit ThreadPool(int num_threads = 0);
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool();
+
+  // Returns a pool shared by the whole process, with one worker per hardware
+  // thread.
+  static ThreadPool& Default();
+
+  int num_threads() const { return shares_.size(); }
+
+  using Fn = absl::FunctionRef<void(int worker, std::size_t index)>;
+
+  // Calls 'fn' for every index in [0, count), in no particular order, and
+  // returns once all calls have finished. 'worker' is in [0, num_threads())
+  // and identifies the calling worker, so 'fn' can keep per-worker state.
+  // Calls to ParallelFor() are serialized, and must not be nested.
+  void ParallelFor(std::size_t count, Fn fn);
+
+ private:
+  // The indices a worker has yet to run, packed as [begin, end) into the
+  // upper and lower 32 bits so that they can be claimed with a single
+  // compare-and-swap.
+  struct alignas(64) Share {
+    std::atomic<std::uint64_t> range{0};
+  };
+
+  // Runs indices from worker's own share, then from other workers' shares
+  // until no share has any left to steal.
+  void RunShares(int worker, Fn fn);
+
+  // Claims the first index of 'worker's share. Returns false if it's empty.
+  bool TakeOwn(int worker, std::uint32_t* index);
+
+  // Moves the back half of some other worker's share into 'worker's (empty)
+  // share. Returns false if no share had more than one index left.
+  bool Steal(int worker);
+
+  void WorkerLoop(int worker);
+
+  std::vector<Share> shares_;
+  std::vector<std::thread> threads_;
+
+  absl::Mutex call_mutex_;
+  absl::Mutex mutex_;
+  // The loop being run, if any.
+  const Fn* fn_ ABSL_GUARDED_BY(mutex_) = nullptr;
+  // Incremented for every loop, to wake the workers.
+  std::uint64_t generation_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Threads that haven't yet finished the current loop.
+  int busy_threads_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool shutdown_ ABSL_GUARDED_BY(mutex_) = false;
+};
+
+}  // namespace aoc2019
+
+#endif  // CC_UTIL_THREAD_POOL_H_
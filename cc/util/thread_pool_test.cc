@@ -0,0 +1,85 @@
+// Checks that ParallelFor() calls its function exactly once for every index,
+// from valid workers, for pools and ranges of various sizes, including when
+// some indices take much longer than others so that workers steal.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "cc/util/check.h"
+#include "cc/util/thread_pool.h"
+
+namespace aoc2019 {
+namespace {
+
+// Runs ParallelFor() over 'count' indices and checks that each was visited
+// once. If 'uneven', every 13th index does extra work.
+void CheckVisitsEachIndexOnce(ThreadPool* pool, std::size_t count,
+                              bool uneven) {
+  std::vector<std::atomic<int>> visits(count);
+  std::atomic<bool> bad_worker{false};
+  std::atomic<std::uint64_t> sink{0};
+  pool->ParallelFor(count, [&](const int worker, const std::size_t index) {
+    if (worker < 0 || worker >= pool->num_threads()) bad_worker = true;
+    visits[index].fetch_add(1, std::memory_order_relaxed);
+    if (uneven && index % 13 == 0) {
+      std::uint64_t x = index;
+      for (int i = 0; i < 100000; ++i) x = x * 6364136223846793005 + 1;
+      sink.fetch_add(x, std::memory_order_relaxed);
+    }
+  });
+  CHECK(!bad_worker);
+  for (const std::atomic<int>& visit : visits) CHECK(visit == 1);
+}
+
+void TestVisitsEachIndexOnce() {
+  const int num_hardware_threads =
+      std::max<int>(std::thread::hardware_concurrency(), 1);
+  for (const int num_threads : {1, 2, 0, 7}) {
+    ThreadPool pool(num_threads);
+    CHECK(pool.num_threads() ==
+          (num_threads == 0 ? num_hardware_threads : num_threads));
+    // Ranges smaller than the pool, a prime and a larger prime; run each
+    // twice to check that the pool is reusable.
+    for (const std::size_t count : {0, 1, 2, 97, 10007}) {
+      for (const bool uneven : {false, true}) {
+        CheckVisitsEachIndexOnce(&pool, count, uneven);
+        CheckVisitsEachIndexOnce(&pool, count, uneven);
+      }
+    }
+  }
+}
+
+void TestConcurrentCallers() {
+  // Calls from different threads take turns.
+  ThreadPool pool(3);
+  std::vector<std::thread> callers;
+  for (int caller = 0; caller < 4; ++caller) {
+    callers.emplace_back([&pool] {
+      for (int i = 0; i < 20; ++i) {
+        CheckVisitsEachIndexOnce(&pool, 101, /*uneven=*/false);
+      }
+    });
+  }
+  for (std::thread& caller : callers) caller.join();
+}
+
+void TestDefault() {
+  ThreadPool& pool = ThreadPool::Default();
+  CHECK(&pool == &ThreadPool::Default());
+  CHECK(pool.num_threads() >= 1);
+  CheckVisitsEachIndexOnce(&pool, 997, /*uneven=*/true);
+}
+
+}  // namespace
+}  // namespace aoc2019
+
+int main() {
+  aoc2019::TestVisitsEachIndexOnce();
+  aoc2019::TestConcurrentCallers();
+  aoc2019::TestDefault();
+  return 0;
+}